@@ -7,7 +7,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/GpuMemory.h>
+#include <rg/StartupReport.h>
 
+#include <map>
 #include <string>
 #include <vector>
 using namespace std;
@@ -33,6 +36,13 @@ struct Texture {
     string path;
 };
 
+// The vertices are stored on the GPU as three streams, split by which passes read them:
+//   position  - location 0, every pass including depth-only ones
+//   surface   - normal and texture coordinates, locations 1 and 2, the shading passes
+//   tangents  - tangent and bitangent, locations 3 and 4, normal mapping; uploaded by the first draw that
+//               reads them
+// Draw binds a vertex array with only the attributes the shader reads (Shader::Attributes), one per set of
+// attributes made on first use, so a depth pass fetches nothing but positions.
 class Mesh {
 public:
     // mesh Data
@@ -40,17 +50,24 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; a mesh made off the GL thread passes upload = false and calls Upload() on it later
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if(upload)
+            setupMesh();
+    }
+
+    // creates the buffers the constructor skipped
+    void Upload()
+    {
+        if(!positionVBO)
+            setupMesh();
     }
 
     // render the mesh
@@ -85,7 +102,7 @@ public:
 
 
         // draw mesh
-        glBindVertexArray(VAO);
+        glBindVertexArray(vertexArray(shader.Attributes()));
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
@@ -94,46 +111,109 @@ public:
     }
 
 private:
+    struct SurfaceVertex {
+        glm::vec3 Normal;
+        glm::vec2 TexCoords;
+    };
+    struct TangentVertex {
+        glm::vec3 Tangent;
+        glm::vec3 Bitangent;
+    };
+    static const unsigned int POSITION_ATTRIBUTES = 1u << 0;
+    static const unsigned int SURFACE_ATTRIBUTES = 1u << 1 | 1u << 2;
+    static const unsigned int TANGENT_ATTRIBUTES = 1u << 3 | 1u << 4;
+
     // render data
-    unsigned int VBO, EBO;
+    unsigned int positionVBO = 0, surfaceVBO = 0, tangentVBO = 0, EBO = 0;
+    // per set of attributes
+    std::map<unsigned int, unsigned int> vertexArrays;
 
-    // initializes all the buffer objects/arrays
+    // initializes the buffer objects of the streams every pass or every shading pass reads
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        vector<glm::vec3> positions(vertices.size());
+        vector<SurfaceVertex> surface(vertices.size());
+        for(size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].Position;
+            surface[i] = { vertices[i].Normal, vertices[i].TexCoords };
+        }
+        positionVBO = upload(positions.data(), positions.size() * sizeof(glm::vec3), "mesh positions");
+        surfaceVBO = upload(surface.data(), surface.size() * sizeof(SurfaceVertex), "mesh normals and uvs");
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        EBO = upload(&indices[0], indices.size() * sizeof(unsigned int), "mesh indices");
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // through the copy target, the element array binding belongs to whatever vertex array is bound
+    static unsigned int upload(const void *data, size_t size, const char *name)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        StartupReport::AddBytesUploaded(size);
+        GpuMemory::TrackBuffer(buffer, GpuMemory::MESH, name, size);
+        return buffer;
+    }
 
-        // set the vertex attribute pointers
+    // the vertex array with exactly the requested attributes (that the mesh has) enabled
+    unsigned int vertexArray(unsigned int attributes)
+    {
+        attributes &= POSITION_ATTRIBUTES | SURFACE_ATTRIBUTES | TANGENT_ATTRIBUTES;
+        unsigned int &VAO = vertexArrays[attributes];
+        if(VAO)
+            return VAO;
+        if((attributes & TANGENT_ATTRIBUTES) && !tangentVBO)
+        {
+            vector<TangentVertex> tangents(vertices.size());
+            for(size_t i = 0; i < vertices.size(); i++)
+                tangents[i] = { vertices[i].Tangent, vertices[i].Bitangent };
+            tangentVBO = upload(tangents.data(), tangents.size() * sizeof(TangentVertex), "mesh tangents");
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         // vertex Positions
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        if(attributes & SURFACE_ATTRIBUTES)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
+            // vertex normals
+            if(attributes & 1u << 1)
+            {
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SurfaceVertex), (void*)offsetof(SurfaceVertex, Normal));
+            }
+            // vertex texture coords
+            if(attributes & 1u << 2)
+            {
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SurfaceVertex), (void*)offsetof(SurfaceVertex, TexCoords));
+            }
+        }
+        if(attributes & TANGENT_ATTRIBUTES)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, tangentVBO);
+            // vertex tangent
+            if(attributes & 1u << 3)
+            {
+                glEnableVertexAttribArray(3);
+                glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TangentVertex), (void*)offsetof(TangentVertex, Tangent));
+            }
+            // vertex bitangent
+            if(attributes & 1u << 4)
+            {
+                glEnableVertexAttribArray(4);
+                glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(TangentVertex), (void*)offsetof(TangentVertex, Bitangent));
+            }
+        }
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return VAO;
     }
 };
 #endif
\ No newline at end of file
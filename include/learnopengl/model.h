@@ -7,12 +7,18 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
 #include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/GpuMemory.h>
+#include <rg/JobSystem.h>
+#include <rg/StartupReport.h>
 
+#include <deque>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -21,7 +27,59 @@
 #include <vector>
 using namespace std;
 
+// a texture file decoded into memory, not handed to GL yet
+struct TextureImage
+{
+    int width = 0, height = 0, nrComponents = 0;
+    unsigned char *data = nullptr;
+};
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// the two halves of TextureFromFile: decoding touches no GL and can run on any thread, uploading frees the image
+bool DecodeTexture(const string &filename, TextureImage &image);
+unsigned int UploadTexture(const string &filename, TextureImage &image);
+
+// the files Assimp opens for a model, with every byte read from them reported to the startup report;
+// a model is more than its main file (.mtl, .bin, ...)
+class StartupReportIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    using Assimp::DefaultIOSystem::Open;
+
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override
+    {
+        Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
+        return stream ? new CountingStream(stream) : nullptr;
+    }
+
+    void Close(Assimp::IOStream *file) override
+    {
+        CountingStream *stream = static_cast<CountingStream *>(file);
+        Assimp::DefaultIOSystem::Close(stream->inner);
+        stream->inner = nullptr;
+        delete stream;
+    }
+
+private:
+    struct CountingStream : public Assimp::IOStream
+    {
+        Assimp::IOStream *inner;
+
+        explicit CountingStream(Assimp::IOStream *inner) : inner(inner) {}
+
+        size_t Read(void *buffer, size_t size, size_t count) override
+        {
+            size_t read = inner->Read(buffer, size, count);
+            StartupReport::AddBytesRead(read * size);
+            return read;
+        }
+        size_t Write(const void *buffer, size_t size, size_t count) override { return inner->Write(buffer, size, count); }
+        aiReturn Seek(size_t offset, aiOrigin origin) override { return inner->Seek(offset, origin); }
+        size_t Tell() const override { return inner->Tell(); }
+        size_t FileSize() const override { return inner->FileSize(); }
+        void Flush() override { inner->Flush(); }
+    };
+};
 
 
 
@@ -40,6 +98,22 @@ public:
         loadModel(path);
     }
 
+    // loads the model on the job system: Assimp and the texture decoding run on worker threads, the buffers
+    // and textures are made in a main thread job once everything is decoded. `loaded` reaches zero when the
+    // model can be drawn; until then it must stay where it is and be left alone.
+    Model(string const &path, JobSystem &jobs, JobSystem::Counter &loaded, bool gamma = false) : gammaCorrection(gamma)
+    {
+        loading.reset(new Loading());
+        loading->jobs = &jobs;
+        loading->path = path;
+        jobs.Run([this, &loaded]()
+        {
+            loadModel(loading->path);
+            // queued before this job ends, so `loaded` doesn't reach zero in between
+            loading->jobs->RunOnMainThread([this]() { upload(); }, &loaded, &loading->decoded);
+        }, &loaded);
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -53,11 +127,40 @@ public:
         }
     }
 private:
+    // state of a model loading on the job system, gone once it's uploaded
+    struct Loading
+    {
+        JobSystem *jobs;
+        string path;
+        deque<TextureImage> images; // one per textures_loaded entry; a deque, the decode jobs hold pointers
+        JobSystem::Counter decoded;
+    };
+    unique_ptr<Loading> loading;
+
+    // the main thread half of loading on the job system
+    void upload()
+    {
+        StartupReport::Asset asset("model upload", loading->path);
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            textures_loaded[i].id = UploadTexture(this->directory + '/' + textures_loaded[i].path, loading->images[i]);
+        for(Mesh &mesh : meshes)
+        {
+            for(Texture &texture : mesh.textures)
+                for(const Texture &loadedTexture : textures_loaded)
+                    if(loadedTexture.path == texture.path)
+                        texture.id = loadedTexture.id;
+            mesh.Upload();
+        }
+        loading.reset();
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        StartupReport::Asset asset("model", path);
         // read file via ASSIMP
         Assimp::Importer importer;
+        importer.SetIOHandler(new StartupReportIOSystem()); // the importer owns and deletes it
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -179,7 +282,7 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, !loading);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +308,20 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                if(loading)
+                {   // decoded by a job, the id is filled in by upload()
+                    loading->images.push_back(TextureImage());
+                    TextureImage *image = &loading->images.back();
+                    string filename = this->directory + '/' + str.C_Str();
+                    loading->jobs->Run([image, filename]()
+                    {
+                        StartupReport::Asset asset("texture", filename);
+                        DecodeTexture(filename, *image);
+                    }, &loading->decoded);
+                    texture.id = 0;
+                }
+                else
+                    texture.id = TextureFromFile(str.C_Str(), this->directory);
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -221,37 +337,50 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    StartupReport::Asset asset("texture", filename);
+
+    TextureImage image;
+    DecodeTexture(filename, image);
+    return UploadTexture(filename, image);
+}
 
+bool DecodeTexture(const string &filename, TextureImage &image)
+{
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+    StartupReport::AddBytesRead(StartupReport::FileSize(filename));
+    if (!image.data)
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
+    return image.data != nullptr;
+}
+
+unsigned int UploadTexture(const string &filename, TextureImage &image)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.data)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.nrComponents == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.nrComponents == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.nrComponents == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+        StartupReport::AddBytesUploaded((size_t) image.width * image.height * image.nrComponents);
         glGenerateMipmap(GL_TEXTURE_2D);
+        GpuMemory::TrackTexture(textureID, GpuMemory::MATERIAL_TEXTURE, filename, image.width, image.height, format, true);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        stbi_image_free(image.data);
+        image.data = nullptr;
     }
 
     return textureID;
@@ -4,104 +4,192 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/GLExtensions.h>
+#include <rg/ProgramCache.h>
+#include <rg/ShaderPreprocessor.h>
+#include <rg/StartupReport.h>
+class ShaderBatch;
+
 class Shader
 {
 public:
     unsigned int ID;
+    // one stage of the program and the file it's read from
+    struct Stage
+    {
+        GLenum type;
+        std::string path;
+    };
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        StartupReport::Asset asset("shader", std::string(vertexPath) + " " + fragmentPath);
+        stages.push_back({ GL_VERTEX_SHADER, vertexPath });
+        stages.push_back({ GL_FRAGMENT_SHADER, fragmentPath });
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
+            stages.push_back({ GL_GEOMETRY_SHADER, geometryPath });
+        ID = submit();
+    }
+    // constructor for a compute-only program, needs a GL 4.3 context
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        StartupReport::Asset asset("shader", computePath);
+        stages.push_back({ GL_COMPUTE_SHADER, computePath });
+        ID = submit();
+    }
+    // constructor for a permutation: any stages, compiled with the defines inserted after #version
+    // ------------------------------------------------------------------------
+    Shader(const std::vector<Stage> &stages, const ShaderDefines &defines)
+        : stages(stages), defines(defines)
+    {
+        std::string name;
+        for(const ShaderDefines::value_type &define : defines)
+            name += " " + define.first + (define.second.empty() ? "" : "=" + define.second);
+        StartupReport::Asset asset("shader", stages.front().path + name);
+        ID = submit();
+    }
+    const std::vector<Stage> &Stages() const
+    {
+        return stages;
+    }
+    const ShaderDefines &Defines() const
+    {
+        return defines;
+    }
+    // the stage files and everything they #include, as read when the program was constructed
+    const std::vector<std::string> &Files() const
+    {
+        return files;
+    }
+    // a program handed to the driver: compiled and linked, or loaded from the cache, but nobody has looked at
+    // the result yet, so a driver that compiles in the background hasn't been made to wait
+    struct Pending
+    {
+        unsigned int program;
+        ProgramCache::Key key;
+        std::vector<unsigned int> shaders; // empty when the program came from the cache
+        bool read;                         // every file was found
+    };
+    // reads, preprocesses, compiles and links the stages into a new program, or loads its cached binary; linked
+    // tells whether that worked, a program that failed is returned anyway like the constructors always did
+    // ------------------------------------------------------------------------
+    static unsigned int Build(const std::vector<Stage> &stages, const ShaderDefines &defines = ShaderDefines(),
+                              bool *linked = nullptr, std::vector<std::string> *files = nullptr)
+    {
+        Pending pending = Submit(stages, defines, files);
+        bool success = Finish(pending);
+        if(linked)
+            *linked = success;
+        return pending.program;
+    }
+    // the first half of Build: issues everything without waiting for any of it
+    // ------------------------------------------------------------------------
+    static Pending Submit(const std::vector<Stage> &stages, const ShaderDefines &defines,
+                          std::vector<std::string> *files)
+    {
+        // 1. retrieve the source code from the files, includes resolved and defines inserted
+        std::vector<std::pair<GLenum, std::string>> sources;
+        bool read = true;
+        if(files)
+            files->clear();
+        for(const Stage &stage : stages)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            std::vector<std::string> stageFiles;
+            bool ok;
+            sources.push_back({ stage.type, ShaderPreprocessor::Process(stage.path, defines, stageFiles, ok) });
+            read &= ok;
+            StartupReport::AddBytesRead(sources.back().second.size());
+            if(files)
+                files->insert(files->end(), stageFiles.begin(), stageFiles.end());
         }
-        catch (std::ifstream::failure& e)
+        // a cached binary of the same sources skips compiling and linking
+        Pending pending = { glCreateProgram(), ProgramCache::MakeKey(sources), {}, read };
+        if(ProgramCache::Load(pending.program, pending.key))
+            return pending;
+        // 2. compile shaders; the status is checked in Finish, linking a stage that failed just fails the link
+        for(const std::pair<GLenum, std::string> &source : sources)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            const char* code = source.second.c_str();
+            unsigned int shader = glCreateShader(source.first);
+            glShaderSource(shader, 1, &code, NULL);
+            glCompileShader(shader);
+            glAttachShader(pending.program, shader);
+            pending.shaders.push_back(shader);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        // shader Program
+        ProgramCache::PrepareLink(pending.program);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+    // with KHR_parallel_shader_compile: true once Finish won't have to wait, always true without it
+    // ------------------------------------------------------------------------
+    static bool Ready(const Pending &pending)
+    {
+        if(!rg::glCaps.parallelShaderCompile)
+            return true;
+        GLint complete = GL_TRUE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete;
+    }
+    // the second half of Build: waits for the program, prints the errors and stores the binary; true if it linked
+    // ------------------------------------------------------------------------
+    static bool Finish(Pending &pending)
+    {
+        if(pending.shaders.empty())
+            return true;
+        bool compiled = true;
+        for(unsigned int shader : pending.shaders)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            GLint type;
+            glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+            compiled &= checkCompileErrors(shader, stageName(type));
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        bool success = checkCompileErrors(pending.program, "PROGRAM") && compiled && pending.read;
+        if(success)
+            ProgramCache::Store(pending.program, pending.key);
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for(unsigned int shader : pending.shaders)
+            glDeleteShader(shader);
+        pending.shaders.clear();
+        return success;
+    }
+    // bit i is set when the program reads the vertex attribute at location i, so a mesh can leave every other
+    // attribute disabled; looked up again after the program changed (hot reload)
+    // ------------------------------------------------------------------------
+    unsigned int Attributes() const
+    {
+        if(attributesProgram == ID)
+            return attributes;
+        attributes = 0;
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        for(GLint i = 0; i < count; i++)
+        {
+            char name[256];
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(ID, i, sizeof(name), NULL, &size, &type, name);
+            // built-ins like gl_VertexID are listed too but have no location
+            GLint location = glGetAttribLocation(ID, name);
+            // matrices take a location per column
+            GLint slots = size * (type == GL_FLOAT_MAT4 ? 4 : type == GL_FLOAT_MAT3 ? 3 : type == GL_FLOAT_MAT2 ? 2 : 1);
+            for(GLint slot = location; location >= 0 && slot < location + slots && slot < 32; slot++)
+                attributes |= 1u << slot;
+        }
+        attributesProgram = ID;
+        return attributes;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -169,9 +257,27 @@ public:
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::vector<Stage> stages;
+    ShaderDefines defines;
+    std::vector<std::string> files;
+    mutable unsigned int attributes = 0, attributesProgram = 0;
+
+    // builds the program, or only submits it when a ShaderBatch is open; defined after ShaderBatch
+    unsigned int submit();
+
+    static const char *stageName(GLenum type)
+    {
+        switch(type)
+        {
+            case GL_VERTEX_SHADER: return "VERTEX";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_GEOMETRY_SHADER: return "GEOMETRY";
+            default: return "COMPUTE";
+        }
+    }
+    // utility function for checking shader compilation/linking errors, true when there were none.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +299,94 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
+
+// Compiles a group of programs together. While a batch is open, the Shader constructors only submit their
+// stages and link (Shader::Submit) and return with the ID of a program that may still be compiling; Finish()
+// then waits for all of them, prints the errors and fills the program cache. Nothing may use those programs
+// before Finish, work that needs them goes to OnFinish.
+// With KHR_parallel_shader_compile the driver compiles on its own threads in the meantime and Finish takes the
+// programs in the order they complete. Without it most drivers compile inside the calls, and Finish collects
+// the programs in order, which is the same as building them one by one.
+class ShaderBatch
+{
+public:
+    ShaderBatch()
+    {
+        previous = current();
+        current() = this;
+        // let the driver pick the number of threads
+        if(rg::glCaps.parallelShaderCompile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    ~ShaderBatch()
+    {
+        Finish();
+    }
+    // the innermost open batch on this thread, NULL outside of one
+    static ShaderBatch *Current()
+    {
+        return current();
+    }
+    void Add(const Shader::Pending &program)
+    {
+        pending.push_back(program);
+    }
+    // runs after every program of the batch is finished
+    void OnFinish(std::function<void()> callback)
+    {
+        callbacks.push_back(callback);
+    }
+    // closes the batch, later Shaders are built right away again; returns how many programs failed
+    unsigned int Finish()
+    {
+        if(finished)
+            return 0;
+        finished = true;
+        current() = previous;
+        unsigned int failed = 0;
+        while(!pending.empty())
+        {
+            // the first program that's done, polled until one is
+            size_t next = 0;
+            while(next < pending.size() && !Shader::Ready(pending[next]))
+                next++;
+            if(next == pending.size())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            failed += Shader::Finish(pending[next]) ? 0 : 1;
+            pending.erase(pending.begin() + next);
+        }
+        for(const std::function<void()> &callback : callbacks)
+            callback();
+        callbacks.clear();
+        return failed;
+    }
+
+private:
+    std::vector<Shader::Pending> pending;
+    std::vector<std::function<void()>> callbacks;
+    ShaderBatch *previous = nullptr;
+    bool finished = false;
+
+    static ShaderBatch *&current()
+    {
+        static thread_local ShaderBatch *batch = nullptr;
+        return batch;
+    }
+};
+
+inline unsigned int Shader::submit()
+{
+    ShaderBatch *batch = ShaderBatch::Current();
+    if(!batch)
+        return Build(stages, defines, nullptr, &files);
+    Pending pending = Submit(stages, defines, &files);
+    batch->Add(pending);
+    return pending.program;
+}
 #endif
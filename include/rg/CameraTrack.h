@@ -0,0 +1,150 @@
+#ifndef PROJECT_BASE_CAMERATRACK_H
+#define PROJECT_BASE_CAMERATRACK_H
+
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// camera and input state of one recorded frame
+struct CameraTrackFrame {
+    float deltaTime;     // frame clock delta of the recorded frame
+    glm::vec3 position;
+    float yaw, pitch, zoom;
+    int shipTurn;
+    float shipTilt;
+    bool ssao;
+};
+
+// A recorded flythrough: one CameraTrackFrame per rendered frame, split into named segments.
+// Stored as text, one frame per line, so tracks diff and merge like source:
+//
+//     rg-camera-track 1
+//     segment approach
+//     <dt> <x> <y> <z> <yaw> <pitch> <zoom> <turn> <tilt> <ssao>
+//     ...
+//
+// Floats are written with enough digits to read back bit-identical.
+class CameraTrack {
+public:
+    struct Segment {
+        std::string name;
+        unsigned int firstFrame;
+    };
+
+    void Clear()
+    {
+        frames.clear();
+        segments.clear();
+        times.clear();
+    }
+
+    // the segment starts with the next recorded frame
+    void BeginSegment(const std::string &name)
+    {
+        if (!segments.empty() && segments.back().firstFrame == frames.size())
+            segments.back().name = name;
+        else
+            segments.push_back({ name, (unsigned int) frames.size() });
+    }
+
+    void Record(const CameraTrackFrame &frame)
+    {
+        if (segments.empty())
+            BeginSegment("track");
+        times.push_back((times.empty() ? 0.0 : times.back()) + frame.deltaTime);
+        frames.push_back(frame);
+    }
+
+    bool Save(const std::string &path) const
+    {
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "CAMERA_TRACK::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        out << "rg-camera-track 1\n" << std::setprecision(9);
+        unsigned int segment = 0;
+        for (unsigned int i = 0; i < frames.size(); i++) {
+            while (segment < segments.size() && segments[segment].firstFrame == i)
+                out << "segment " << segments[segment++].name << "\n";
+            const CameraTrackFrame &f = frames[i];
+            out << f.deltaTime << " " << f.position.x << " " << f.position.y << " " << f.position.z << " "
+                << f.yaw << " " << f.pitch << " " << f.zoom << " " << f.shipTurn << " " << f.shipTilt << " "
+                << (f.ssao ? 1 : 0) << "\n";
+        }
+        return (bool) out;
+    }
+
+    bool Load(const std::string &path)
+    {
+        Clear();
+        std::ifstream in(path);
+        std::string line;
+        if (!in || !std::getline(in, line) || line.compare(0, 15, "rg-camera-track") != 0) {
+            std::cout << "CAMERA_TRACK::FILE_NOT_READ: " << path << std::endl;
+            return false;
+        }
+        while (std::getline(in, line)) {
+            if (line.empty())
+                continue;
+            if (line.compare(0, 8, "segment ") == 0) {
+                BeginSegment(line.substr(8));
+                continue;
+            }
+            std::istringstream fields(line);
+            CameraTrackFrame f;
+            int ssao = 0;
+            fields >> f.deltaTime >> f.position.x >> f.position.y >> f.position.z >> f.yaw >> f.pitch >> f.zoom
+                   >> f.shipTurn >> f.shipTilt >> ssao;
+            if (!fields) {
+                std::cout << "CAMERA_TRACK::BAD_FRAME: " << line << std::endl;
+                Clear();
+                return false;
+            }
+            f.ssao = ssao != 0;
+            Record(f);
+        }
+        return !frames.empty();
+    }
+
+    unsigned int FrameCount() const
+    {
+        return frames.size();
+    }
+
+    const CameraTrackFrame &Frame(unsigned int frame) const
+    {
+        return frames[frame];
+    }
+
+    // recorded time of the frame, the sum of the deltas up to and including it
+    double TimeAt(unsigned int frame) const
+    {
+        return times[frame];
+    }
+
+    const std::vector<Segment> &Segments() const
+    {
+        return segments;
+    }
+
+    unsigned int SegmentOf(unsigned int frame) const
+    {
+        unsigned int segment = 0;
+        while (segment + 1 < segments.size() && segments[segment + 1].firstFrame <= frame)
+            segment++;
+        return segment;
+    }
+
+private:
+    std::vector<CameraTrackFrame> frames;
+    std::vector<Segment> segments;
+    std::vector<double> times;
+};
+
+#endif //PROJECT_BASE_CAMERATRACK_H
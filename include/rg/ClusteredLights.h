@@ -0,0 +1,249 @@
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GpuMemory.h>
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct PointLight {
+    glm::vec3 Position; // world space
+    glm::vec3 Color;
+    float Radius;       // the light has no effect past this distance
+};
+
+// Bins point lights into a froxel grid (screen tiles x exponential depth slices) on the CPU and stores
+// the result in three texture buffers the lighting pass reads from:
+//   lightData    - 2 RGBA32F texels per light: view-space position + radius, color
+//   clusterGrid  - RG32UI per cluster: offset into lightIndices, number of lights
+//   lightIndices - R32UI light indices, grouped by cluster
+// so every pixel only evaluates the lights whose bounds overlap its cluster.
+//
+// A texture buffer holds at most GL_MAX_TEXTURE_BUFFER_SIZE texels, only 65536 guaranteed on GL 3.3, which
+// thousands of lights can pass in lightIndices. Pairs past the limit are dropped: the cluster that reaches it
+// keeps the lights that fit, the ones after it get none, and Dropped() counts the loss so it doesn't go unseen.
+class ClusteredLights {
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    ClusteredLights(unsigned int width, unsigned int height) : width(width), height(height)
+    {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        maxIndices = std::max(maxTexels, 65536);
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        for (unsigned int i = 0; i < 3; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            GpuMemory::TrackBuffer(buffers[i], GpuMemory::OTHER, bufferName(i), 16);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        grid.resize(CLUSTER_COUNT * 2);
+        fill.resize(CLUSTER_COUNT);
+    }
+
+    // assigns every light to the clusters its bounding sphere touches and uploads the light buffers; with jobs
+    // the lights are bounded in parallel, the counting and scattering into clusters stays on this thread
+    void Update(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                float zNear, float zFar, JobSystem *jobs = NULL)
+    {
+        RG_PROFILE_ZONE("light culling");
+        sliceScale = SLICES / std::log(zFar / zNear);
+        sliceBias = -(float) SLICES * std::log(zNear) / std::log(zFar / zNear);
+
+        lightData.resize(lights.size() * 8);
+        lightRanges.resize(lights.size());
+        auto bound = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].Position, 1.0f));
+                float radius = lights[i].Radius;
+                float *data = &lightData[i * 8];
+                data[0] = center.x; data[1] = center.y; data[2] = center.z; data[3] = radius;
+                data[4] = lights[i].Color.x; data[5] = lights[i].Color.y; data[6] = lights[i].Color.z; data[7] = 0.0f;
+
+                ClusterRange &range = lightRanges[i];
+                range.light = CULLED;
+                // view space looks down -z, so the near side of the sphere has the larger z
+                float nearDistance = -(center.z + radius);
+                float farDistance = -(center.z - radius);
+                if (farDistance < zNear || nearDistance > zFar)
+                    continue;
+                range.z0 = slice(std::max(nearDistance, zNear));
+                range.z1 = slice(std::min(farDistance, zFar));
+                if (screenBounds(center, radius, projection, zNear, range))
+                    range.light = i;
+            }
+        };
+        if (jobs)
+            jobs->ParallelFor(lights.size(), 64, bound);
+        else
+            bound(0, lights.size());
+
+        ranges.clear();
+        std::fill(grid.begin(), grid.end(), 0u);
+        for (const ClusterRange &range : lightRanges) {
+            if (range.light == CULLED)
+                continue;
+            ranges.push_back(range);
+            for (unsigned int z = range.z0; z <= range.z1; z++)
+                for (unsigned int y = range.y0; y <= range.y1; y++)
+                    for (unsigned int x = range.x0; x <= range.x1; x++)
+                        grid[clusterIndex(x, y, z) * 2 + 1]++;
+        }
+
+        // prefix sum the per-cluster counts into offsets, cut at what the index buffer can hold, then scatter
+        // the light indices
+        unsigned int offset = 0;
+        droppedCount = 0;
+        for (unsigned int c = 0; c < CLUSTER_COUNT; c++) {
+            unsigned int count = std::min(grid[c * 2 + 1], maxIndices - offset);
+            droppedCount += grid[c * 2 + 1] - count;
+            grid[c * 2] = offset;
+            grid[c * 2 + 1] = count;
+            offset += count;
+        }
+        indices.resize(std::max(offset, 1u));
+        std::fill(fill.begin(), fill.end(), 0u);
+        for (const ClusterRange &range : ranges) {
+            for (unsigned int z = range.z0; z <= range.z1; z++)
+                for (unsigned int y = range.y0; y <= range.y1; y++)
+                    for (unsigned int x = range.x0; x <= range.x1; x++) {
+                        unsigned int c = clusterIndex(x, y, z);
+                        if (fill[c] < grid[c * 2 + 1])
+                            indices[grid[c * 2] + fill[c]++] = range.light;
+                    }
+        }
+        indexCount = offset;
+
+        upload(0, lightData.empty() ? NULL : &lightData[0], lightData.size() * sizeof(float));
+        upload(1, &grid[0], grid.size() * sizeof(unsigned int));
+        upload(2, &indices[0], indices.size() * sizeof(unsigned int));
+    }
+
+    // binds the light buffers to three consecutive texture units and sets the cluster lookup uniforms;
+    // expects the shader to be in use
+    void Bind(Shader &shader, unsigned int firstTextureUnit) const
+    {
+        const char *samplers[3] = { "lightData", "clusterGrid", "lightIndices" };
+        for (unsigned int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            shader.setInt(samplers[i], firstTextureUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        shader.setVec2("clusterTileScale", (float) TILES_X / width, (float) TILES_Y / height);
+        shader.setFloat("clusterSliceScale", sliceScale);
+        shader.setFloat("clusterSliceBias", sliceBias);
+    }
+
+    // total light/cluster pairs written last update, useful to see how well the culling works
+    unsigned int IndexCount() const
+    {
+        return indexCount;
+    }
+
+    // light/cluster pairs of the last update that didn't fit in the index buffer, see the class comment
+    unsigned int Dropped() const
+    {
+        return droppedCount;
+    }
+
+private:
+    struct ClusterRange {
+        unsigned int light;
+        unsigned int x0, x1, y0, y1, z0, z1;
+    };
+    // the light of a range outside the view
+    static const unsigned int CULLED = ~0u;
+
+    unsigned int width, height;
+    unsigned int buffers[3];
+    unsigned int textures[3];
+    float sliceScale = 1.0f, sliceBias = 0.0f;
+    unsigned int indexCount = 0;
+    unsigned int droppedCount = 0;
+    unsigned int maxIndices;  // texels of lightIndices
+    std::vector<float> lightData;
+    std::vector<unsigned int> grid;
+    std::vector<unsigned int> fill; // per cluster, indices scattered so far
+    std::vector<unsigned int> indices;
+    std::vector<ClusterRange> ranges;
+    std::vector<ClusterRange> lightRanges; // one per light, CULLED ones included
+
+    static const char *bufferName(unsigned int buffer)
+    {
+        static const char *names[3] = { "clustered light data", "clustered light grid", "clustered light indices" };
+        return names[buffer];
+    }
+
+    static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return (z * TILES_Y + y) * TILES_X + x;
+    }
+
+    unsigned int slice(float distance) const
+    {
+        int s = (int) std::floor(std::log(distance) * sliceScale + sliceBias);
+        return (unsigned int) std::min(std::max(s, 0), (int) SLICES - 1);
+    }
+
+    // projects the view-space box around the sphere to find the tiles it covers
+    static bool screenBounds(const glm::vec3 &center, float radius, const glm::mat4 &projection, float zNear,
+                             ClusterRange &range)
+    {
+        range.x0 = 0; range.x1 = TILES_X - 1;
+        range.y0 = 0; range.y1 = TILES_Y - 1;
+        // spheres crossing the near plane can cover any part of the screen
+        if (center.z + radius > -zNear)
+            return true;
+        glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 p = center + radius * glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f,
+                                                      corner & 4 ? 1.0f : -1.0f);
+            glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+            glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+            ndcMin = glm::vec2(std::min(ndcMin.x, ndc.x), std::min(ndcMin.y, ndc.y));
+            ndcMax = glm::vec2(std::max(ndcMax.x, ndc.x), std::max(ndcMax.y, ndc.y));
+        }
+        if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+            return false;
+        range.x0 = tile(ndcMin.x, TILES_X);
+        range.x1 = tile(ndcMax.x, TILES_X);
+        range.y0 = tile(ndcMin.y, TILES_Y);
+        range.y1 = tile(ndcMax.y, TILES_Y);
+        return true;
+    }
+
+    static unsigned int tile(float ndc, unsigned int tiles)
+    {
+        int t = (int) std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return (unsigned int) std::min(std::max(t, 0), (int) tiles - 1);
+    }
+
+    void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        // orphan the old storage so the driver doesn't wait for last frame's lighting pass
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t) 16), NULL, GL_STREAM_DRAW);
+        GpuMemory::TrackBuffer(buffers[buffer], GpuMemory::OTHER, bufferName(buffer), std::max(size, (size_t) 16));
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
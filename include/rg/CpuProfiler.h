@@ -0,0 +1,148 @@
+#ifndef PROJECT_BASE_CPUPROFILER_H
+#define PROJECT_BASE_CPUPROFILER_H
+
+#include <rg/Json.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU zones. Every thread records finished zones into its own fixed-size ring buffer, so
+// recording never allocates and only takes the buffer's own, uncontended lock; the newest events
+// overwrite the oldest. WriteChromeTrace dumps what the rings hold as Trace Event JSON that
+// chrome://tracing and Perfetto open directly. Zones nest, the viewers rebuild the hierarchy from
+// the timestamps.
+//
+// The RG_PROFILE_* macros only record when the build defines RG_CPU_PROFILER (the CMake option of the
+// same name); otherwise they expand to nothing and the zones cost nothing.
+class CpuProfiler {
+public:
+    static const unsigned int RING_SIZE = 1 << 16;
+
+    struct Event {
+        const char *name; // must outlive the profiler, string literals are expected
+        int64_t start;    // nanoseconds since the profiler's epoch
+        int64_t end;
+    };
+
+    class Zone {
+    public:
+        explicit Zone(const char *name) : name(name), start(Now()) {}
+        ~Zone() { Record(name, start, Now()); }
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+    private:
+        const char *name;
+        int64_t start;
+    };
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch()).count();
+    }
+
+    static void Record(const char *name, int64_t start, int64_t end)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events[buffer.written % RING_SIZE] = { name, start, end };
+        buffer.written++;
+    }
+
+    // names the calling thread in the trace
+    static void SetThreadName(const std::string &name)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    // writes the zones all threads still hold in their rings; returns false if the file can't be written
+    static bool WriteChromeTrace(const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        // microseconds with nanosecond resolution, never in exponent notation
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        std::lock_guard<std::mutex> registryLock(registry().mutex);
+        for (const std::shared_ptr<ThreadBuffer> &buffer : registry().buffers) {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"args\":{\"name\":\"" << rg::escapeJSON(buffer->name) << "\"}}";
+            first = false;
+            uint64_t begin = buffer->written > RING_SIZE ? buffer->written - RING_SIZE : 0;
+            for (uint64_t i = begin; i < buffer->written; i++) {
+                const Event &event = buffer->events[i % RING_SIZE];
+                out << ",\n{\"name\":\"" << rg::escapeJSON(event.name)
+                    << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":"
+                    << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+            }
+        }
+        out << "\n]}\n";
+        return (bool) out;
+    }
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;
+        uint64_t written = 0;
+        unsigned int id = 0;
+        std::string name;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    };
+
+    static std::chrono::steady_clock::time_point epoch()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    static Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    // the registry shares ownership, so a thread's zones stay exportable after the thread exits
+    static ThreadBuffer &threadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            buffer->events.resize(RING_SIZE);
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            buffer->id = registry().buffers.size() + 1;
+            buffer->name = "thread " + std::to_string(buffer->id);
+            registry().buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+};
+
+#define RG_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef RG_CPU_PROFILER
+#define RG_PROFILE_ZONE(name) CpuProfiler::Zone RG_PROFILE_CONCAT(rgProfileZone, __LINE__)(name)
+#define RG_PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+#define RG_PROFILE_ZONE(name)
+#define RG_PROFILE_THREAD(name)
+#endif
+
+#endif //PROJECT_BASE_CPUPROFILER_H
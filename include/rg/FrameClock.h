@@ -0,0 +1,137 @@
+#ifndef PROJECT_BASE_FRAMECLOCK_H
+#define PROJECT_BASE_FRAMECLOCK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+
+// The one place the render loop gets time from. Tick() samples the time source once at the start of a
+// frame and everything in that frame reads the same values, so all objects animate at the same instant.
+// Simulation advances in fixed steps:
+//
+//     frameClock.Tick();
+//     while (frameClock.Step())
+//         simulate(frameClock.FixedStep());
+//     render(lerp(previousState, currentState, frameClock.Alpha()));
+//
+// which makes it independent of the frame rate. Steps are counted, not accumulated, so a given sequence of
+// samples always produces the same number of steps. The time source can be swapped, replays and
+// benchmarks use FixedTime() to get a fixed, reproducible amount of time per frame.
+class FrameClock {
+public:
+    typedef std::function<double()> TimeSource;
+
+    // catching up further than this after a stall (breakpoint, loading) is skipped instead of simulated
+    static constexpr double MAX_CATCH_UP = 0.25;
+
+    explicit FrameClock(double fixedStep = 1.0 / 60.0, TimeSource source = SteadyTime())
+            : fixedStep(fixedStep), source(source) {}
+
+    // seconds from a monotonic clock
+    static TimeSource SteadyTime()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return [start]() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+    }
+
+    // advances by exactly `step` seconds per sample, starting at 0
+    static TimeSource FixedTime(double step)
+    {
+        std::shared_ptr<unsigned long> samples = std::make_shared<unsigned long>(0);
+        return [samples, step]() {
+            return (*samples)++ * step;
+        };
+    }
+
+    // switches the source and restarts the clock at 0 on the next Tick
+    void SetTimeSource(TimeSource timeSource)
+    {
+        source = timeSource;
+        started = false;
+    }
+
+    void Tick()
+    {
+        double sample = source();
+        if (!started) {
+            origin = sample;
+            time = 0.0;
+            steps = 0;
+            frame = 0;
+            started = true;
+        }
+        else
+            frame++;
+        double previous = time;
+        time = sample - origin;
+        // drop the part of a long stall that would take more than MAX_CATCH_UP to simulate
+        double behind = time - steps * fixedStep;
+        if (behind > MAX_CATCH_UP) {
+            double skipped = behind - MAX_CATCH_UP;
+            origin += skipped;
+            time -= skipped;
+        }
+        delta = std::max(0.0, time - previous);
+    }
+
+    // true while there's a whole fixed step left to simulate this frame
+    bool Step()
+    {
+        // the small tolerance keeps e.g. 3 * (1/60) from missing the third step to rounding
+        if (time - (steps + 1) * fixedStep > -1e-9) {
+            steps++;
+            return true;
+        }
+        return false;
+    }
+
+    // seconds since the first Tick, sampled once per frame
+    double Time() const
+    {
+        return time;
+    }
+
+    // seconds since the previous Tick
+    float DeltaTime() const
+    {
+        return (float) delta;
+    }
+
+    float FixedStep() const
+    {
+        return (float) fixedStep;
+    }
+
+    // how far the frame is between the previous and the current simulation step, in [0, 1]
+    float Alpha() const
+    {
+        return (float) std::min(1.0, std::max(0.0, (time - steps * fixedStep) / fixedStep));
+    }
+
+    // time of the interpolated simulation state that is rendered, one step behind Time()
+    double InterpolatedTime() const
+    {
+        return steps == 0 ? 0.0 : (steps - 1 + Alpha()) * fixedStep;
+    }
+
+    unsigned long Frame() const
+    {
+        return frame;
+    }
+
+private:
+    double fixedStep;
+    TimeSource source;
+    bool started = false;
+    double origin = 0.0;
+    double time = 0.0;
+    double delta = 0.0;
+    unsigned long steps = 0;
+    unsigned long frame = 0;
+};
+
+#endif //PROJECT_BASE_FRAMECLOCK_H
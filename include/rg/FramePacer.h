@@ -0,0 +1,179 @@
+#ifndef PROJECT_BASE_FRAMEPACER_H
+#define PROJECT_BASE_FRAMEPACER_H
+
+#include <glad/glad.h>
+#include <imgui.h>
+#include <rg/LatencyProbe.h>
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <thread>
+
+// When frames start and how far the CPU may run ahead of the GPU.
+//   vsync       - the swap interval the window should use: off, on, or adaptive (late frames tear instead of
+//                 waiting a whole refresh, needs EXT_swap_control_tear); applying it is up to the window owner
+//   frame cap   - WaitForFrameStart holds the frame until 1/cap after the previous one started. It sleeps
+//                 while the remaining time is longer than the sleeps have been overshooting, then spins, so
+//                 frames start within a few microseconds of the deadline without burning a core
+//   in flight   - FramePresented fences every frame and waits for the fence of the frame `max` frames back,
+//                 so the driver can't queue more; 1 gives the lowest latency, 0 leaves it to the driver
+class FramePacer {
+public:
+    enum Vsync {
+        VSYNC_OFF,
+        VSYNC_ON,
+        VSYNC_ADAPTIVE,
+        VSYNC_MODE_COUNT
+    };
+
+    static const char *VsyncName(Vsync mode)
+    {
+        static const char *names[VSYNC_MODE_COUNT] = { "off", "on", "adaptive" };
+        return names[mode];
+    }
+
+    // for glfwSwapInterval
+    static int SwapInterval(Vsync mode)
+    {
+        return mode == VSYNC_OFF ? 0 : mode == VSYNC_ON ? 1 : -1;
+    }
+
+    Vsync GetVsync() const
+    {
+        return vsync;
+    }
+
+    void SetVsync(Vsync mode)
+    {
+        vsync = mode;
+    }
+
+    // frames per second, 0 for no cap
+    void SetFrameCap(double fps)
+    {
+        period = fps > 0.0 ? 1.0 / fps : 0.0;
+    }
+
+    double FrameCap() const
+    {
+        return period > 0.0 ? 1.0 / period : 0.0;
+    }
+
+    // 0 for no limit
+    void SetMaxFramesInFlight(unsigned int frames)
+    {
+        maxFramesInFlight = frames;
+    }
+
+    unsigned int MaxFramesInFlight() const
+    {
+        return maxFramesInFlight;
+    }
+
+    // call before the frame samples input; true when it held the frame, input should be polled again then
+    bool WaitForFrameStart()
+    {
+        capWait = 0.0;
+        if (period <= 0.0) {
+            started = false;
+            return false;
+        }
+        Clock::time_point now = Clock::now();
+        if (!started || now >= nextStart) {
+            // the first frame, or one that is already late: start now instead of catching up with short frames
+            nextStart = now + seconds(period);
+            started = true;
+            return false;
+        }
+        sleepUntil(nextStart);
+        Clock::time_point start = Clock::now();
+        capWait = std::chrono::duration<double>(start - now).count();
+        // small overshoots are made up by the next frame, one the scheduler delayed for long re-anchors the cadence
+        if (start - nextStart > seconds(period * 0.5))
+            nextStart = start;
+        nextStart += seconds(period);
+        return true;
+    }
+
+    // call right after the swap
+    void FramePresented()
+    {
+        fenceWait = 0.0;
+        if (maxFramesInFlight == 0) {
+            while (!fences.empty()) {
+                glDeleteSync(fences.front());
+                fences.pop_front();
+            }
+            return;
+        }
+        fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        Clock::time_point start = Clock::now();
+        while (fences.size() > maxFramesInFlight) {
+            glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            glDeleteSync(fences.front());
+            fences.pop_front();
+        }
+        fenceWait = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // pacing settings, this frame's waits and the input latency; call between ImGui::NewFrame and ImGui::Render
+    void DrawImGui(const LatencyProbe &latency) const
+    {
+        ImGui::SetNextWindowPos(ImVec2(1100.0f, 10.0f), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.6f);
+        ImGui::Begin("Frame pacing", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::Text("vsync %s, cap %s, in flight %s", VsyncName(vsync),
+                    period > 0.0 ? (std::to_string((int) std::round(FrameCap())) + " fps").c_str() : "off",
+                    maxFramesInFlight ? std::to_string(maxFramesInFlight).c_str() : "driver");
+        ImGui::Text("cap wait %.3f ms, fence wait %.3f ms, 1 ms sleeps take %.3f ms", capWait * 1000.0,
+                    fenceWait * 1000.0, sleepEstimate * 1000.0);
+        ImGui::Separator();
+        LatencyProbe::Stats present = latency.PresentStats(), complete = latency.CompleteStats();
+        ImGui::Text("input to present   p50 %6.2f  p99 %6.2f  max %6.2f ms", present.p50, present.p99, present.max);
+        ImGui::Text("input to GPU done  p50 %6.2f  p99 %6.2f  max %6.2f ms", complete.p50, complete.p99, complete.max);
+        ImGui::End();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // a fence that hasn't signaled by then belongs to a lost or hung frame, don't wait on it forever
+    static const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+    static constexpr double SLEEP_QUANTUM = 0.001;
+
+    Vsync vsync = VSYNC_ON;
+    double period = 0.0;
+    unsigned int maxFramesInFlight = 0;
+    bool started = false;
+    Clock::time_point nextStart;
+    std::deque<GLsync> fences;
+    double capWait = 0.0, fenceWait = 0.0;
+    // how long a SLEEP_QUANTUM sleep really takes: running mean and variance (Welford), and mean + deviation
+    double sleepMean = SLEEP_QUANTUM, sleepM2 = 0.0, sleepEstimate = SLEEP_QUANTUM;
+    unsigned long sleepCount = 1;
+
+    static Clock::duration seconds(double s)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+    }
+
+    void sleepUntil(Clock::time_point deadline)
+    {
+        while (std::chrono::duration<double>(deadline - Clock::now()).count() > sleepEstimate) {
+            Clock::time_point before = Clock::now();
+            std::this_thread::sleep_for(seconds(SLEEP_QUANTUM));
+            double observed = std::chrono::duration<double>(Clock::now() - before).count();
+            sleepCount++;
+            double delta = observed - sleepMean;
+            sleepMean += delta / sleepCount;
+            sleepM2 += delta * (observed - sleepMean);
+            sleepEstimate = sleepMean + std::sqrt(sleepM2 / (sleepCount - 1));
+        }
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+};
+
+#endif //PROJECT_BASE_FRAMEPACER_H
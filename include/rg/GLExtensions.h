@@ -0,0 +1,136 @@
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// The bundled glad loader only covers core 3.3. Entry points from newer versions and extensions that
+// are used on an optional fast path are declared and loaded here, the same way glad does it, and
+// rg::glCaps tells which of those paths the current context supports.
+
+// GL 4.2 / 4.3: image load/store and compute shaders
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                   GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+
+// ARB_pipeline_statistics_query (core in 4.6)
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+
+// ARB_get_program_binary (core in 4.1)
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                   GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary,
+                                                GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile (same tokens as the ARB version)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// ARB_buffer_storage (core in 4.4): immutable buffers that can stay mapped while the GPU reads them
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+static PFNGLDISPATCHCOMPUTEPROC rg_glDispatchCompute = NULL;
+static PFNGLBINDIMAGETEXTUREPROC rg_glBindImageTexture = NULL;
+static PFNGLMEMORYBARRIERPROC rg_glMemoryBarrier = NULL;
+#define glDispatchCompute rg_glDispatchCompute
+#define glBindImageTexture rg_glBindImageTexture
+#define glMemoryBarrier rg_glMemoryBarrier
+
+static PFNGLGETPROGRAMBINARYPROC rg_glGetProgramBinary = NULL;
+static PFNGLPROGRAMBINARYPROC rg_glProgramBinary = NULL;
+static PFNGLPROGRAMPARAMETERIPROC rg_glProgramParameteri = NULL;
+#define glGetProgramBinary rg_glGetProgramBinary
+#define glProgramBinary rg_glProgramBinary
+#define glProgramParameteri rg_glProgramParameteri
+
+static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC rg_glMaxShaderCompilerThreadsKHR = NULL;
+#define glMaxShaderCompilerThreadsKHR rg_glMaxShaderCompilerThreadsKHR
+
+static PFNGLBUFFERSTORAGEPROC rg_glBufferStorage = NULL;
+#define glBufferStorage rg_glBufferStorage
+
+namespace rg {
+
+    struct GLCapabilities {
+        int major = 0;
+        int minor = 0;
+        bool computeShaders = false;
+        bool pipelineStatistics = false;
+        bool programBinary = false;
+        bool parallelShaderCompile = false;
+        bool bufferStorage = false;
+
+        bool atLeast(int requiredMajor, int requiredMinor) const {
+            return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+        }
+    };
+
+    static GLCapabilities glCaps;
+
+    static bool hasGLExtension(const char *name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // call once after gladLoadGLLoader with the same loader
+    static const GLCapabilities &loadGLExtensions(GLADloadproc load) {
+        glGetIntegerv(GL_MAJOR_VERSION, &glCaps.major);
+        glGetIntegerv(GL_MINOR_VERSION, &glCaps.minor);
+
+        if (glCaps.atLeast(4, 3)) {
+            rg_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC) load("glDispatchCompute");
+            rg_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC) load("glBindImageTexture");
+            rg_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC) load("glMemoryBarrier");
+            glCaps.computeShaders = rg_glDispatchCompute && rg_glBindImageTexture && rg_glMemoryBarrier;
+        }
+        glCaps.pipelineStatistics = glCaps.atLeast(4, 6) || hasGLExtension("GL_ARB_pipeline_statistics_query");
+
+        if (glCaps.atLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+            rg_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC) load("glGetProgramBinary");
+            rg_glProgramBinary = (PFNGLPROGRAMBINARYPROC) load("glProgramBinary");
+            rg_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC) load("glProgramParameteri");
+            // drivers may expose the entry points but no formats to store, e.g. Mesa without a disk cache
+            GLint formats = 0;
+            if (rg_glGetProgramBinary && rg_glProgramBinary && rg_glProgramParameteri)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            glCaps.programBinary = formats > 0;
+        }
+
+        if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+            rg_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsKHR");
+        else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+            rg_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsARB");
+        glCaps.parallelShaderCompile = rg_glMaxShaderCompilerThreadsKHR != NULL;
+
+        if (glCaps.atLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+            rg_glBufferStorage = (PFNGLBUFFERSTORAGEPROC) load("glBufferStorage");
+        glCaps.bufferStorage = rg_glBufferStorage != NULL;
+        return glCaps;
+    }
+
+};
+
+#endif //PROJECT_BASE_GLEXTENSIONS_H
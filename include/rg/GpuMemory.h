@@ -0,0 +1,199 @@
+#ifndef PROJECT_BASE_GPUMEMORY_H
+#define PROJECT_BASE_GPUMEMORY_H
+
+#include <glad/glad.h>
+#include <imgui.h>
+#include <rg/Json.h>
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A central record of the GL memory the program allocates. Every place that creates storage reports the
+// object with a tag and a size estimate; re-tracking an object replaces its entry (resized buffers,
+// reallocated render targets) and releasing it removes it. GL can't tell how much memory an object
+// really takes, so the sizes are estimates: texel size times texel count, with the whole mip chain for
+// mipmapped textures and 3-channel formats counted at 4 bytes per texel as drivers pad them.
+class GpuMemory {
+public:
+    enum Tag {
+        MESH,
+        MATERIAL_TEXTURE,
+        CUBEMAP,
+        RENDER_TARGET,
+        OTHER,
+        TAG_COUNT
+    };
+
+    struct Allocation {
+        Tag tag;
+        std::string name;
+        size_t bytes;
+    };
+
+    static const char *TagName(Tag tag)
+    {
+        static const char *names[TAG_COUNT] = { "mesh", "material texture", "cubemap", "render target", "other" };
+        return names[tag];
+    }
+
+    // bytes per texel of an internal format; unsized formats count as their 8 bit versions
+    static unsigned int BytesPerTexel(GLenum internalFormat)
+    {
+        switch (internalFormat) {
+            case GL_RED:
+            case GL_R8:
+                return 1;
+            case GL_RG:
+            case GL_RG8:
+            case GL_R16F:
+                return 2;
+            case GL_RGBA16F:
+            case GL_RG32F:
+            case GL_RG32UI:
+                return 8;
+            case GL_RGBA32F:
+            case GL_RGBA32UI:
+                return 16;
+            case GL_RGB16F:
+                return 8;  // padded to RGBA16F
+            case GL_RGB32F:
+                return 16; // padded to RGBA32F
+            default:
+                return 4;  // RGB(A)8, R32F, R32UI, RG16F, DEPTH24_STENCIL8, DEPTH_COMPONENT24
+        }
+    }
+
+    // texels of all layers, and of all mip levels down to 1x1 when mipmapped
+    static size_t TextureBytes(unsigned int width, unsigned int height, GLenum internalFormat, bool mipmaps = false,
+                               unsigned int layers = 1)
+    {
+        size_t texels = 0;
+        while (true) {
+            texels += (size_t) width * height;
+            if (!mipmaps || (width == 1 && height == 1))
+                break;
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+        return texels * layers * BytesPerTexel(internalFormat);
+    }
+
+    static void TrackTexture(GLuint id, Tag tag, const std::string &name, unsigned int width, unsigned int height,
+                             GLenum internalFormat, bool mipmaps = false, unsigned int layers = 1)
+    {
+        allocations()[{ TEXTURE, id }] = { tag, name, TextureBytes(width, height, internalFormat, mipmaps, layers) };
+    }
+
+    static void TrackRenderbuffer(GLuint id, Tag tag, const std::string &name, unsigned int width,
+                                  unsigned int height, GLenum internalFormat)
+    {
+        allocations()[{ RENDERBUFFER, id }] = { tag, name, TextureBytes(width, height, internalFormat) };
+    }
+
+    static void TrackBuffer(GLuint id, Tag tag, const std::string &name, size_t bytes)
+    {
+        allocations()[{ BUFFER, id }] = { tag, name, bytes };
+    }
+
+    static void ReleaseTexture(GLuint id)
+    {
+        allocations().erase({ TEXTURE, id });
+    }
+
+    static void ReleaseRenderbuffer(GLuint id)
+    {
+        allocations().erase({ RENDERBUFFER, id });
+    }
+
+    static void ReleaseBuffer(GLuint id)
+    {
+        allocations().erase({ BUFFER, id });
+    }
+
+    static size_t TagBytes(Tag tag)
+    {
+        size_t bytes = 0;
+        for (const auto &entry : allocations())
+            if (entry.second.tag == tag)
+                bytes += entry.second.bytes;
+        return bytes;
+    }
+
+    static size_t TotalBytes()
+    {
+        size_t bytes = 0;
+        for (const auto &entry : allocations())
+            bytes += entry.second.bytes;
+        return bytes;
+    }
+
+    // the largest allocations first
+    static std::vector<Allocation> Largest(size_t count)
+    {
+        std::vector<Allocation> result;
+        for (const auto &entry : allocations())
+            result.push_back(entry.second);
+        std::sort(result.begin(), result.end(), [](const Allocation &a, const Allocation &b) {
+            return a.bytes > b.bytes;
+        });
+        if (result.size() > count)
+            result.resize(count);
+        return result;
+    }
+
+    // per-tag totals and the ten largest allocations; call between ImGui::NewFrame and ImGui::Render
+    static void DrawImGui()
+    {
+        ImGui::SetNextWindowPos(ImVec2(10.0f, 560.0f), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.6f);
+        ImGui::Begin("GPU memory", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+        for (unsigned int tag = 0; tag < TAG_COUNT; tag++)
+            ImGui::Text("%-18s %9.2f MiB", TagName((Tag) tag), TagBytes((Tag) tag) / MIB);
+        ImGui::Separator();
+        ImGui::Text("%-18s %9.2f MiB in %u objects", "total", TotalBytes() / MIB, (unsigned int) allocations().size());
+        ImGui::Separator();
+        for (const Allocation &allocation : Largest(10))
+            ImGui::Text("%9.2f MiB  %-16s %s", allocation.bytes / MIB, TagName(allocation.tag),
+                        allocation.name.c_str());
+        ImGui::End();
+    }
+
+    // a JSON object with the per-tag and total bytes and every allocation
+    static void WriteJSON(std::ostream &out, const std::string &indent)
+    {
+        out << "{\n" << indent << "  \"total_bytes\": " << TotalBytes() << ",\n";
+        out << indent << "  \"tags\": {";
+        for (unsigned int tag = 0; tag < TAG_COUNT; tag++)
+            out << (tag ? ", " : "") << "\"" << TagName((Tag) tag) << "\": " << TagBytes((Tag) tag);
+        out << "},\n" << indent << "  \"allocations\": [";
+        bool first = true;
+        for (const Allocation &allocation : Largest(allocations().size())) {
+            out << (first ? "" : ",") << "\n" << indent << "    {\"tag\": \"" << TagName(allocation.tag)
+                << "\", \"name\": \"" << rg::escapeJSON(allocation.name) << "\", \"bytes\": " << allocation.bytes
+                << "}";
+            first = false;
+        }
+        out << "\n" << indent << "  ]\n" << indent << "}";
+    }
+
+private:
+    enum Kind {
+        TEXTURE,
+        RENDERBUFFER,
+        BUFFER
+    };
+
+    static constexpr float MIB = 1024.0f * 1024.0f;
+
+    static std::map<std::pair<Kind, GLuint>, Allocation> &allocations()
+    {
+        static std::map<std::pair<Kind, GLuint>, Allocation> instance;
+        return instance;
+    }
+};
+
+#endif //PROJECT_BASE_GPUMEMORY_H
@@ -0,0 +1,189 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Measures GPU time per render pass with GL_TIME_ELAPSED queries. Every pass owns one query per frame in
+// flight; a frame's results are only read when its queries come around again FRAMES_IN_FLIGHT frames later
+// and only if GL_QUERY_RESULT_AVAILABLE says so, so the profiler never makes the CPU wait for the GPU.
+// Results that still aren't ready by then are dropped rather than waited for.
+// Timer queries can't nest: Begin/End pairs of different passes must not overlap.
+class GpuProfiler {
+public:
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    static const unsigned int HISTORY_SIZE = 240;
+
+    struct PassStats {
+        unsigned int samples = 0;
+        float last = 0.0f, min = 0.0f, avg = 0.0f, max = 0.0f, p99 = 0.0f; // milliseconds
+    };
+
+    explicit GpuProfiler(const std::vector<std::string> &passNames) : names(passNames), passes(passNames.size())
+    {
+        queries.resize(FRAMES_IN_FLIGHT * passes.size());
+        issued.assign(queries.size(), false);
+        glGenQueries((GLsizei) queries.size(), &queries[0]);
+        for (Pass &pass : passes)
+            pass.history.assign(HISTORY_SIZE, 0.0f);
+    }
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    // collects whatever finished from the frame that last used this frame's queries
+    void BeginFrame()
+    {
+        collect(frame % FRAMES_IN_FLIGHT, false);
+    }
+
+    void Begin(unsigned int pass)
+    {
+        if (!enabled)
+            return;
+        unsigned int i = (frame % FRAMES_IN_FLIGHT) * passes.size() + pass;
+        glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+        issued[i] = true;
+    }
+
+    void End(unsigned int pass)
+    {
+        if (!enabled)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    void EndFrame()
+    {
+        frame++;
+    }
+
+    // waits for every outstanding query; only for benchmarks that want this frame's numbers right away
+    void Flush()
+    {
+        for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+            collect(slot, true);
+    }
+
+    void Reset()
+    {
+        for (Pass &pass : passes) {
+            pass.head = 0;
+            pass.count = 0;
+        }
+        dropped = 0;
+    }
+
+    void SetEnabled(bool value)
+    {
+        enabled = value;
+    }
+
+    unsigned int PassCount() const
+    {
+        return passes.size();
+    }
+
+    const std::string &Name(unsigned int pass) const
+    {
+        return names[pass];
+    }
+
+    // results that were discarded because the GPU hadn't finished them in time
+    unsigned int Dropped() const
+    {
+        return dropped;
+    }
+
+    PassStats Stats(unsigned int pass) const
+    {
+        PassStats stats;
+        const Pass &p = passes[pass];
+        if (p.count == 0)
+            return stats;
+        std::vector<float> sorted(p.count);
+        for (unsigned int i = 0; i < p.count; i++)
+            sorted[i] = p.history[(p.head + HISTORY_SIZE - p.count + i) % HISTORY_SIZE];
+        stats.samples = p.count;
+        stats.last = sorted.back();
+        std::sort(sorted.begin(), sorted.end());
+        stats.min = sorted.front();
+        stats.max = sorted.back();
+        float sum = 0.0f;
+        for (float value : sorted)
+            sum += value;
+        stats.avg = sum / p.count;
+        stats.p99 = sorted[std::min(p.count - 1, (unsigned int) (p.count * 0.99f))];
+        return stats;
+    }
+
+    // rolling graph and min/avg/max/p99 per pass; call between ImGui::NewFrame and ImGui::Render
+    void DrawImGui() const
+    {
+        ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.6f);
+        ImGui::Begin("GPU passes", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+        float total = 0.0f;
+        for (unsigned int pass = 0; pass < passes.size(); pass++) {
+            const Pass &p = passes[pass];
+            if (p.count == 0)
+                continue;
+            PassStats stats = Stats(pass);
+            total += stats.avg;
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%.3f ms", stats.last);
+            // a full ring starts at head, a partial one at 0
+            ImGui::PlotLines(names[pass].c_str(), &p.history[0], p.count, p.count == HISTORY_SIZE ? p.head : 0,
+                             overlay, 0.0f, stats.max * 1.2f, ImVec2(240.0f, 40.0f));
+            ImGui::Text("min %.3f  avg %.3f  max %.3f  p99 %.3f", stats.min, stats.avg, stats.max, stats.p99);
+        }
+        ImGui::Separator();
+        ImGui::Text("total avg %.3f ms, dropped %u", total, dropped);
+        ImGui::End();
+    }
+
+private:
+    struct Pass {
+        std::vector<float> history;
+        unsigned int head = 0;
+        unsigned int count = 0;
+    };
+
+    std::vector<std::string> names;
+    std::vector<Pass> passes;
+    std::vector<GLuint> queries;
+    std::vector<bool> issued;
+    unsigned int frame = 0;
+    unsigned int dropped = 0;
+    bool enabled = true;
+
+    void collect(unsigned int slot, bool wait)
+    {
+        for (unsigned int pass = 0; pass < passes.size(); pass++) {
+            unsigned int i = slot * passes.size() + pass;
+            if (!issued[i])
+                continue;
+            issued[i] = false;
+            GLint available = GL_FALSE;
+            if (!wait)
+                glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!wait && !available) {
+                dropped++;
+                continue;
+            }
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+            Pass &p = passes[pass];
+            p.history[p.head] = elapsed / 1.0e6f;
+            p.head = (p.head + 1) % HISTORY_SIZE;
+            p.count = std::min(p.count + 1, (unsigned int) HISTORY_SIZE);
+        }
+    }
+};
+
+#endif //PROJECT_BASE_GPUPROFILER_H
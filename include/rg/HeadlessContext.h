@@ -0,0 +1,110 @@
+#ifndef PROJECT_BASE_HEADLESSCONTEXT_H
+#define PROJECT_BASE_HEADLESSCONTEXT_H
+
+#ifdef RG_HEADLESS
+
+#include <glad/glad.h>
+#include <rg/GpuMemory.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <iostream>
+
+// An OpenGL core context without a window, for benchmark runs on machines with no display (Mesa's
+// llvmpipe included). EGL is asked for the surfaceless platform first and the default display after
+// that; the context is made current without a surface, so the frame is rendered into an offscreen
+// framebuffer that stands in for the window's default framebuffer.
+class HeadlessContext {
+public:
+    // creates and makes current a core context of the requested version
+    bool Create(int major, int minor)
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint eglMajor, eglMinor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor)) {
+            std::cout << "HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "HEADLESS::OPENGL_API_NOT_SUPPORTED" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+        };
+        EGLConfig config = NULL;
+        EGLint configCount = 0;
+        eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+        const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, major,
+                EGL_CONTEXT_MINOR_VERSION, minor,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+        };
+        context = eglCreateContext(display, configCount > 0 ? config : (EGLConfig) NULL, EGL_NO_CONTEXT,
+                                   contextAttributes);
+        if (context == EGL_NO_CONTEXT)
+            return false;
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cout << "HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // loader for gladLoadGLLoader
+    static void *GetProcAddress(const char *name)
+    {
+        return (void *) eglGetProcAddress(name);
+    }
+
+    // needs loaded GL functions; returns the framebuffer to render the frame into instead of 0
+    unsigned int CreateFramebuffer(unsigned int width, unsigned int height)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        GpuMemory::TrackRenderbuffer(renderbuffers[0], GpuMemory::RENDER_TARGET, "headless color", width, height, GL_RGBA8);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        GpuMemory::TrackRenderbuffer(renderbuffers[1], GpuMemory::RENDER_TARGET, "headless depth-stencil", width,
+                                     height, GL_DEPTH24_STENCIL8);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "HEADLESS::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+        return framebuffer;
+    }
+
+    void Destroy()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    unsigned int framebuffer = 0;
+    unsigned int renderbuffers[2] = { 0, 0 };
+};
+
+#endif
+
+#endif //PROJECT_BASE_HEADLESSCONTEXT_H
@@ -0,0 +1,313 @@
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <rg/CpuProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A fixed pool of worker threads with work stealing. Every worker has its own deque: it pushes and pops the
+// jobs it spawns at the back (the newest, still in cache), and a worker that runs dry steals from the front
+// of the others' (the oldest, usually the biggest pieces of work). Threads outside the pool push to a shared
+// queue the workers steal from too.
+//
+// Counters tie jobs together: a job run with a counter increments it when it's queued and decrements it when
+// it's done. Wait(counter) runs jobs on the calling thread until the counter reaches zero, so waiting never
+// idles a thread and nested waits can't deadlock. A job run `after` a counter is held back until that counter
+// reaches zero, which is how one job depends on a group of others.
+//
+// GL calls belong to the thread that owns the context: RunOnMainThread queues a job for the thread that made
+// the JobSystem, which runs them in RunMainThreadJobs (once per frame) and whenever it waits.
+//
+// With 0 workers every job runs on the thread that waits for it, in the order they were queued.
+class JobSystem {
+public:
+    typedef std::function<void()> Job;
+    class Counter;
+
+private:
+    struct Task {
+        Job job;
+        Counter *counter;
+        bool mainThread;
+    };
+
+public:
+    class Counter {
+    public:
+        Counter() = default;
+        Counter(const Counter &) = delete;
+        Counter &operator=(const Counter &) = delete;
+
+        bool Done() const
+        {
+            return pending.load() == 0;
+        }
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<int> pending{ 0 };
+        std::mutex mutex;
+        std::vector<Task> continuations;
+    };
+
+    // one thread per core besides the main thread
+    static unsigned int DefaultWorkers()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    explicit JobSystem(unsigned int workers = DefaultWorkers()) : mainThread(std::this_thread::get_id())
+    {
+        queues = std::vector<Queue>(workers + 1);
+        for (unsigned int i = 1; i <= workers; i++)
+            threads.push_back(std::thread(&JobSystem::work, this, i));
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    unsigned int Workers() const
+    {
+        return threads.size();
+    }
+
+    // counter and after may be NULL
+    void Run(Job job, Counter *counter = NULL, Counter *after = NULL)
+    {
+        submit({ std::move(job), counter, false }, after);
+    }
+
+    // for GL work, see the class comment
+    void RunOnMainThread(Job job, Counter *counter = NULL, Counter *after = NULL)
+    {
+        submit({ std::move(job), counter, true }, after);
+    }
+
+    // runs jobs on the calling thread until the counter is zero
+    void Wait(Counter &counter)
+    {
+        bool onMainThread = std::this_thread::get_id() == mainThread;
+        while (!counter.Done()) {
+            if (onMainThread && RunMainThreadJobs())
+                continue;
+            Task task;
+            if (find(ownQueue(), task))
+                execute(task);
+            else
+                std::this_thread::yield();
+        }
+        // the thread that finished the last job may still hold the lock, the caller may destroy the counter next
+        std::lock_guard<std::mutex> lock(counter.mutex);
+    }
+
+    // call on the main thread; true if it ran anything
+    bool RunMainThreadJobs()
+    {
+        std::vector<Task> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            tasks.swap(mainTasks);
+        }
+        for (Task &task : tasks)
+            execute(task);
+        return !tasks.empty();
+    }
+
+    // function(begin, end) over [0, count) in ranges of `grain` items, returns when all are done; a single
+    // range runs right here without queuing anything
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &function)
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || threads.empty()) {
+            if (count > 0)
+                function(0, count);
+            return;
+        }
+        Counter counter;
+        // the caller takes the first range itself
+        for (size_t begin = grain; begin < count; begin += grain) {
+            size_t end = std::min(begin + grain, count);
+            Run([&function, begin, end]() { function(begin, end); }, &counter);
+        }
+        function(0, grain);
+        Wait(counter);
+    }
+
+    // sorts ranges of `grain` elements in parallel, then merges them pairwise, each level in parallel
+    template <typename Iterator, typename Compare>
+    void ParallelSort(Iterator first, Iterator last, Compare compare, size_t grain)
+    {
+        size_t count = std::distance(first, last);
+        grain = std::max<size_t>(grain, 1);
+        size_t ranges = (count + grain - 1) / grain;
+        ParallelFor(ranges, 1, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++)
+                std::sort(first + r * grain, first + std::min(count, (r + 1) * grain), compare);
+        });
+        for (size_t width = grain; width < count; width *= 2) {
+            size_t merges = (count + 2 * width - 1) / (2 * width);
+            ParallelFor(merges, 1, [&](size_t begin, size_t end) {
+                for (size_t m = begin; m < end; m++) {
+                    size_t start = m * 2 * width;
+                    size_t middle = std::min(count, start + width), stop = std::min(count, start + 2 * width);
+                    std::inplace_merge(first + start, first + middle, first + stop, compare);
+                }
+            });
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::thread::id mainThread;
+    // [0] is shared by the threads outside the pool, [i] belongs to worker i
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads;
+    std::mutex mainMutex;
+    std::vector<Task> mainTasks;
+    // idle workers sleep until something is queued
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{ 0 };
+    bool stopping = false;
+
+    // the calling thread's queue in this system: a worker's own, 0 for everyone else
+    unsigned int ownQueue() const
+    {
+        return currentSystem() == this ? currentWorker() : 0;
+    }
+
+    static const JobSystem *&currentSystem()
+    {
+        static thread_local const JobSystem *system = NULL;
+        return system;
+    }
+
+    static unsigned int &currentWorker()
+    {
+        static thread_local unsigned int worker = 0;
+        return worker;
+    }
+
+    void submit(Task task, Counter *after)
+    {
+        if (task.counter)
+            task.counter->pending++;
+        if (after) {
+            // the lock orders this against the last job of `after` releasing its continuations
+            std::lock_guard<std::mutex> lock(after->mutex);
+            if (!after->Done()) {
+                after->continuations.push_back(std::move(task));
+                return;
+            }
+        }
+        push(std::move(task));
+    }
+
+    void push(Task task)
+    {
+        if (task.mainThread) {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            mainTasks.push_back(std::move(task));
+            return;
+        }
+        Queue &queue = queues[ownQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // the newest job of the own queue, or the oldest of another one
+    bool find(unsigned int own, Task &task)
+    {
+        if (queued.load() == 0)
+            return false;
+        for (unsigned int i = 0; i < queues.size(); i++) {
+            unsigned int index = (own + i) % queues.size();
+            Queue &queue = queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (index == own) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void execute(Task &task)
+    {
+        task.job();
+        task.job = nullptr;
+        Counter *counter = task.counter;
+        if (!counter)
+            return;
+        // decremented under the lock: a job added `after` the counter either sees it done or gets released here
+        std::vector<Task> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (--counter->pending == 0)
+                released.swap(counter->continuations);
+        }
+        for (Task &continuation : released)
+            push(std::move(continuation));
+    }
+
+    void work(unsigned int index)
+    {
+        currentSystem() = this;
+        currentWorker() = index;
+        RG_PROFILE_THREAD("worker " + std::to_string(index));
+        for (;;) {
+            Task task;
+            if (find(index, task)) {
+                execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
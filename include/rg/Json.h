@@ -0,0 +1,22 @@
+#ifndef PROJECT_BASE_JSON_H
+#define PROJECT_BASE_JSON_H
+
+#include <string>
+
+// Helpers shared by the reports written as JSON (CPU trace, startup report, GPU memory).
+namespace rg {
+
+    // text for inside a JSON string literal: quotes and backslashes escaped
+    inline std::string escapeJSON(const std::string &text) {
+        std::string result;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+}
+
+#endif //PROJECT_BASE_JSON_H
@@ -0,0 +1,156 @@
+#ifndef PROJECT_BASE_LATENCYPROBE_H
+#define PROJECT_BASE_LATENCYPROBE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+// Measures input-to-photon latency. The input callbacks call OnInput; the first event that arrives while no
+// other event is waiting is timestamped, and BeginFrame hands it to the frame that samples the input. When
+// that frame is presented two latencies are recorded:
+//   present  - input until glfwSwapBuffers returned for the frame
+//   complete - input until the GPU finished the frame, a GL timestamp query issued after the swap and
+//              converted to CPU time; the closest a program gets to the photon without looking at the display
+// Only frames that consumed input are measured. Queries are read back without waiting, a few frames late.
+// The probe can outlive the context (it's global so the callbacks reach it), its queries go with the context.
+class LatencyProbe {
+public:
+    // samples kept for the percentiles
+    static const unsigned int WINDOW = 256;
+
+    struct Stats {
+        unsigned int count;   // frames measured
+        unsigned int samples; // of them in the window the percentiles are over
+        double p50, p99, max; // milliseconds
+    };
+
+    void OnInput()
+    {
+        if (!pending) {
+            pending = true;
+            pendingTime = now();
+        }
+    }
+
+    // call once per frame, right before the input is sampled
+    void BeginFrame()
+    {
+        latched = pending;
+        latchedTime = pendingTime;
+        pending = false;
+    }
+
+    // call right after the swap
+    void FramePresented()
+    {
+        if (latched) {
+            double presented = now();
+            record(present, presentCount, presented - latchedTime);
+            if (presented - calibratedAt > RECALIBRATE_SECONDS)
+                calibrate();
+            GLuint query = acquireQuery();
+            glQueryCounter(query, GL_TIMESTAMP);
+            inFlight.push_back({ query, latchedTime });
+            latched = false;
+        }
+        collect();
+    }
+
+    Stats PresentStats() const
+    {
+        return stats(present, presentCount);
+    }
+
+    Stats CompleteStats() const
+    {
+        return stats(complete, completeCount);
+    }
+
+private:
+    struct InFlight {
+        GLuint query;
+        double inputTime;
+    };
+
+    static constexpr double RECALIBRATE_SECONDS = 1.0;
+
+    bool pending = false, latched = false;
+    double pendingTime = 0.0, latchedTime = 0.0;
+    // CPU seconds minus GPU seconds, from the last calibration
+    double gpuToCpu = 0.0;
+    double calibratedAt = -RECALIBRATE_SECONDS;
+    std::vector<GLuint> freeQueries;
+    std::deque<InFlight> inFlight;
+    std::vector<double> present, complete;
+    unsigned int presentCount = 0, completeCount = 0;
+
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // GL_TIMESTAMP is the GPU clock when the command is reached, not when earlier work is done; both clocks
+    // are read back to back so the offset is exact to the read latency
+    void calibrate()
+    {
+        GLint64 gpu;
+        double cpu = now();
+        glGetInteger64v(GL_TIMESTAMP, &gpu);
+        gpuToCpu = cpu - gpu * 1e-9;
+        calibratedAt = cpu;
+    }
+
+    GLuint acquireQuery()
+    {
+        if (freeQueries.empty()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            return query;
+        }
+        GLuint query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+
+    void collect()
+    {
+        while (!inFlight.empty()) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(inFlight.front().query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 gpu;
+            glGetQueryObjectui64v(inFlight.front().query, GL_QUERY_RESULT, &gpu);
+            record(complete, completeCount, gpu * 1e-9 + gpuToCpu - inFlight.front().inputTime);
+            freeQueries.push_back(inFlight.front().query);
+            inFlight.pop_front();
+        }
+    }
+
+    static void record(std::vector<double> &samples, unsigned int &count, double seconds)
+    {
+        double ms = std::max(0.0, seconds * 1000.0);
+        if (samples.size() < WINDOW)
+            samples.push_back(ms);
+        else
+            samples[count % WINDOW] = ms;
+        count++;
+    }
+
+    static Stats stats(std::vector<double> samples, unsigned int count)
+    {
+        Stats result = { count, (unsigned int) samples.size(), 0.0, 0.0, 0.0 };
+        if (samples.empty())
+            return result;
+        std::sort(samples.begin(), samples.end());
+        result.p50 = samples[samples.size() / 2];
+        result.p99 = samples[std::min(samples.size() - 1, (size_t) (samples.size() * 0.99))];
+        result.max = samples.back();
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_LATENCYPROBE_H
@@ -0,0 +1,167 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+#include <rg/StartupReport.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Linked program binaries on disk, so warm starts skip GLSL compilation. Programs are keyed by a 64 bit
+// FNV-1a hash of everything that goes into them: the source of every stage as handed to the driver (with
+// the defines in it) and the GL vendor, renderer and version strings, so a driver update or a shader edit
+// misses instead of loading a stale binary. A driver can still reject a binary it wrote (it changed without
+// changing its strings); Load reports that as a miss, deletes the file and the caller compiles from source.
+//
+// Files are <directory>/<key>.bin: "RGPB", the binary format and the driver's blob.
+class ProgramCache {
+public:
+    typedef uint64_t Key;
+
+    // an empty directory disables the cache
+    static void SetDirectory(const std::string &path)
+    {
+        instance().directory = path;
+        if (!path.empty())
+            mkdir(path.c_str(), 0755);
+    }
+
+    static bool Enabled()
+    {
+        return rg::glCaps.programBinary && !instance().directory.empty();
+    }
+
+    // stages: the sources in attach order, prefixed with their stage so moving code between stages changes the key
+    static Key MakeKey(const std::vector<std::pair<GLenum, std::string>> &stages)
+    {
+        Key hash = FNV_OFFSET;
+        for (const std::pair<GLenum, std::string> &stage : stages) {
+            hash = fnv(hash, &stage.first, sizeof(stage.first));
+            hash = fnv(hash, stage.second.data(), stage.second.size() + 1);
+        }
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char *value = (const char *) glGetString(name);
+            hash = fnv(hash, value ? value : "", value ? std::strlen(value) + 1 : 1);
+        }
+        return hash;
+    }
+
+    // call before glLinkProgram so the driver keeps the binary around for Store
+    static void PrepareLink(GLuint program)
+    {
+        if (Enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // true when the program was linked from the cached binary; it's left unlinked otherwise
+    static bool Load(GLuint program, Key key)
+    {
+        if (!Enabled())
+            return false;
+        std::ifstream in(path(key), std::ios::binary);
+        char magic[4];
+        uint32_t format = 0;
+        if (!in || !in.read(magic, 4) || std::memcmp(magic, "RGPB", 4) != 0 ||
+            !in.read((char *) &format, sizeof(format))) {
+            instance().misses++;
+            return false;
+        }
+        std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        StartupReport::AddBytesRead(binary.size() + 8);
+        glProgramBinary(program, format, binary.data(), binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // an unknown format raises GL_INVALID_ENUM, don't leave it for the next error check
+            while (glGetError() != GL_NO_ERROR)
+                ;
+            std::remove(path(key).c_str());
+            instance().rejected++;
+            instance().misses++;
+            return false;
+        }
+        instance().hits++;
+        return true;
+    }
+
+    // after a successful link from source
+    static void Store(GLuint program, Key key)
+    {
+        if (!Enabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, binary.data());
+        // written under a temporary name and renamed, so a crash can't leave a truncated binary behind
+        std::string target = path(key), temporary = target + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        uint32_t format32 = format;
+        out.write("RGPB", 4);
+        out.write((const char *) &format32, sizeof(format32));
+        out.write(binary.data(), binary.size());
+        out.close();
+        if (out)
+            std::rename(temporary.c_str(), target.c_str());
+        else
+            std::remove(temporary.c_str());
+    }
+
+    static unsigned int Hits()
+    {
+        return instance().hits;
+    }
+
+    // includes the rejected binaries
+    static unsigned int Misses()
+    {
+        return instance().misses;
+    }
+
+    static unsigned int Rejected()
+    {
+        return instance().rejected;
+    }
+
+private:
+    static const Key FNV_OFFSET = 14695981039346656037ull;
+    static const Key FNV_PRIME = 1099511628211ull;
+
+    std::string directory;
+    unsigned int hits = 0, misses = 0, rejected = 0;
+
+    static ProgramCache &instance()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    static Key fnv(Key hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        return hash;
+    }
+
+    static std::string path(Key key)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long) key);
+        return instance().directory + "/" + name + ".bin";
+    }
+};
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
@@ -0,0 +1,316 @@
+#ifndef PROJECT_BASE_REGRESSIONSUITE_H
+#define PROJECT_BASE_REGRESSIONSUITE_H
+
+#include <stb_image.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks rendered views against stored goldens, for the ctest regression tests.
+//
+// Images are compared perceptually: every pixel's CIE76 color difference (Delta E in CIELAB) is computed
+// and the image fails when more than `imageTolerance` percent of the pixels differ by more than
+// JUST_NOTICEABLE, so rasterization noise along edges passes and a changed shading term doesn't.
+// Floating point targets (G-buffer positions and normals, whose components are negative as often as not)
+// are stored as PFM and compared per channel instead: a pixel differs when any channel is off by more than
+// FLOAT_ABSOLUTE or FLOAT_RELATIVE of the golden value, whichever is larger, with the same percent tolerance.
+//
+// Timings are compared as medians against <golden>/<view>.timings, and only when the baseline was
+// recorded on the same GL renderer; a timing regresses when it is more than `perfThreshold` (a fraction)
+// and MIN_REGRESSION_MS slower than the baseline.
+//
+// With updateGolden the rendered images and timings replace the goldens instead. Views without goldens
+// are skipped, Result() returns SKIPPED (the tests' SKIP_RETURN_CODE) when nothing could be compared;
+// with requireGolden a missing golden image or timing baseline fails instead. A baseline recorded on
+// another renderer is still skipped, it says nothing about this one.
+class RegressionSuite {
+public:
+    static const int SKIPPED = 77;
+    static constexpr float JUST_NOTICEABLE = 2.3f;
+    static constexpr float FLOAT_ABSOLUTE = 0.01f;
+    static constexpr float FLOAT_RELATIVE = 0.01f;
+    static constexpr double MIN_REGRESSION_MS = 0.05;
+
+    typedef std::vector<std::pair<std::string, std::vector<double>>> Timings;
+
+    RegressionSuite(const std::string &goldenDirectory, const std::string &outputDirectory, bool updateGolden,
+                    float imageTolerance, float perfThreshold, bool requireGolden = false)
+            : goldenDirectory(goldenDirectory), outputDirectory(outputDirectory), updateGolden(updateGolden),
+              requireGolden(requireGolden), imageTolerance(imageTolerance), perfThreshold(perfThreshold)
+    {
+        makeDirectories(outputDirectory);
+        if (updateGolden)
+            makeDirectories(goldenDirectory);
+    }
+
+    // where the rendered image of this name has to be written before CompareImage, a PNG
+    std::string OutputPath(const std::string &image) const
+    {
+        return outputDirectory + "/" + image + ".png";
+    }
+
+    // the same for CompareFloatImage, a PFM
+    std::string FloatOutputPath(const std::string &image) const
+    {
+        return outputDirectory + "/" + image + ".pfm";
+    }
+
+    bool CompareImage(const std::string &image)
+    {
+        std::string goldenPath = goldenDirectory + "/" + image + ".png";
+        if (updateGolden)
+            return update(OutputPath(image), goldenPath);
+
+        int width, height, goldenWidth, goldenHeight, channels;
+        unsigned char *golden = stbi_load(goldenPath.c_str(), &goldenWidth, &goldenHeight, &channels, 3);
+        if (!golden)
+            return missingGolden(image, goldenPath);
+        unsigned char *rendered = stbi_load(OutputPath(image).c_str(), &width, &height, &channels, 3);
+        bool passed = false;
+        if (!rendered)
+            std::cout << "FAILED  " << image << ": not rendered" << std::endl;
+        else if (width != goldenWidth || height != goldenHeight)
+            std::cout << "FAILED  " << image << ": " << width << "x" << height << ", golden is " << goldenWidth
+                      << "x" << goldenHeight << std::endl;
+        else {
+            size_t pixels = (size_t) width * height, different = 0;
+            double sum = 0.0, worst = 0.0;
+            for (size_t i = 0; i < pixels; i++) {
+                double difference = deltaE(&rendered[i * 3], &golden[i * 3]);
+                sum += difference;
+                worst = std::max(worst, difference);
+                different += difference > JUST_NOTICEABLE;
+            }
+            double percent = 100.0 * different / pixels;
+            passed = percent <= imageTolerance;
+            std::cout << (passed ? "PASSED  " : "FAILED  ") << image << std::fixed << std::setprecision(3)
+                      << ": " << percent << "% of pixels over Delta E " << JUST_NOTICEABLE << " (tolerance "
+                      << imageTolerance << "%), mean " << sum / pixels << ", max " << worst << std::endl;
+        }
+        stbi_image_free(golden);
+        if (rendered)
+            stbi_image_free(rendered);
+        compared = true;
+        failed |= !passed;
+        return passed;
+    }
+
+    bool CompareFloatImage(const std::string &image)
+    {
+        std::string goldenPath = goldenDirectory + "/" + image + ".pfm";
+        if (updateGolden)
+            return update(FloatOutputPath(image), goldenPath);
+
+        unsigned int width, height, goldenWidth, goldenHeight;
+        std::vector<float> golden, rendered;
+        if (!readPFM(goldenPath, goldenWidth, goldenHeight, golden))
+            return missingGolden(image, goldenPath);
+        bool passed = false;
+        if (!readPFM(FloatOutputPath(image), width, height, rendered))
+            std::cout << "FAILED  " << image << ": not rendered" << std::endl;
+        else if (width != goldenWidth || height != goldenHeight)
+            std::cout << "FAILED  " << image << ": " << width << "x" << height << ", golden is " << goldenWidth
+                      << "x" << goldenHeight << std::endl;
+        else {
+            size_t pixels = (size_t) width * height, different = 0;
+            double worst = 0.0;
+            for (size_t i = 0; i < pixels; i++) {
+                bool differs = false;
+                for (size_t c = i * 3; c < i * 3 + 3; c++) {
+                    double difference = std::fabs(rendered[c] - golden[c]);
+                    worst = std::max(worst, difference);
+                    double allowed = FLOAT_RELATIVE * std::fabs(golden[c]);
+                    differs |= difference > (allowed > FLOAT_ABSOLUTE ? allowed : FLOAT_ABSOLUTE);
+                }
+                different += differs;
+            }
+            double percent = 100.0 * different / pixels;
+            passed = percent <= imageTolerance;
+            std::cout << (passed ? "PASSED  " : "FAILED  ") << image << std::fixed << std::setprecision(3)
+                      << ": " << percent << "% of pixels off by more than " << FLOAT_ABSOLUTE << " or "
+                      << FLOAT_RELATIVE * 100.0f << "% (tolerance " << imageTolerance << "%), max " << worst
+                      << std::endl;
+        }
+        compared = true;
+        failed |= !passed;
+        return passed;
+    }
+
+    // timings: name and the per-frame samples in milliseconds, e.g. the frame time and every GPU pass
+    bool CompareTimings(const std::string &view, const std::string &renderer, const Timings &timings)
+    {
+        std::string baselinePath = goldenDirectory + "/" + view + ".timings";
+        if (updateGolden) {
+            std::ofstream out(baselinePath);
+            out << "renderer " << renderer << "\n" << std::fixed << std::setprecision(4);
+            for (const std::pair<std::string, std::vector<double>> &timing : timings)
+                if (!timing.second.empty())
+                    out << median(timing.second) << " " << timing.first << "\n";
+            std::cout << (out ? "UPDATED " : "FAILED  ") << baselinePath << std::endl;
+            failed |= !out;
+            return (bool) out;
+        }
+
+        std::ifstream in(baselinePath);
+        std::string line, baselineRenderer;
+        if (!in || !std::getline(in, line) || line.compare(0, 9, "renderer ") != 0) {
+            std::cout << (requireGolden ? "FAILED  " : "SKIPPED ") << view << " timings: no baseline "
+                      << baselinePath << std::endl;
+            failed |= requireGolden;
+            return !requireGolden;
+        }
+        baselineRenderer = line.substr(9);
+        if (baselineRenderer != renderer) {
+            std::cout << "SKIPPED " << view << " timings: baseline is from " << baselineRenderer << std::endl;
+            return true;
+        }
+        bool passed = true;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            double baseline;
+            std::string name;
+            if (!(fields >> baseline) || !std::getline(fields >> std::ws, name))
+                continue;
+            for (const std::pair<std::string, std::vector<double>> &timing : timings) {
+                if (timing.first != name || timing.second.empty())
+                    continue;
+                double current = median(timing.second);
+                bool regressed = current > baseline * (1.0 + perfThreshold) && current - baseline > MIN_REGRESSION_MS;
+                passed &= !regressed;
+                std::cout << (regressed ? "FAILED  " : "PASSED  ") << view << " " << name << std::fixed
+                          << std::setprecision(3) << ": " << current << " ms, baseline " << baseline
+                          << " ms (threshold +" << perfThreshold * 100.0f << "%)" << std::endl;
+            }
+        }
+        compared = true;
+        failed |= !passed;
+        return passed;
+    }
+
+    // exit code for ctest
+    int Result() const
+    {
+        if (failed)
+            return 1;
+        return compared || updateGolden ? 0 : SKIPPED;
+    }
+
+private:
+    std::string goldenDirectory, outputDirectory;
+    bool updateGolden;
+    bool requireGolden;
+    float imageTolerance, perfThreshold;
+    bool compared = false;
+    bool failed = false;
+
+    bool update(const std::string &rendered, const std::string &goldenPath)
+    {
+        bool copied = copyFile(rendered, goldenPath);
+        std::cout << (copied ? "UPDATED " : "FAILED  ") << goldenPath << std::endl;
+        failed |= !copied;
+        return copied;
+    }
+
+    bool missingGolden(const std::string &image, const std::string &goldenPath)
+    {
+        std::cout << (requireGolden ? "FAILED  " : "SKIPPED ") << image << ": no golden image " << goldenPath
+                  << std::endl;
+        failed |= requireGolden;
+        return !requireGolden;
+    }
+
+    // RGB floats as FrameCapture writes them; a positive scale means big endian
+    static bool readPFM(const std::string &path, unsigned int &width, unsigned int &height,
+                        std::vector<float> &pixels)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string magic;
+        float scale;
+        if (!(in >> magic >> width >> height >> scale) || magic != "PF" || width == 0 || height == 0)
+            return false;
+        in.get(); // the single whitespace before the data
+        pixels.resize((size_t) width * height * 3);
+        if (!in.read((char *) &pixels[0], pixels.size() * sizeof(float)))
+            return false;
+        if (scale > 0.0f) {
+            for (float &value : pixels) {
+                unsigned char *bytes = (unsigned char *) &value;
+                std::swap(bytes[0], bytes[3]);
+                std::swap(bytes[1], bytes[2]);
+            }
+        }
+        return true;
+    }
+
+    static double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    // mkdir -p
+    static void makeDirectories(const std::string &path)
+    {
+        for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        mkdir(path.c_str(), 0755);
+    }
+
+    static bool copyFile(const std::string &from, const std::string &to)
+    {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary);
+        if (!in || !out)
+            return false;
+        out << in.rdbuf();
+        return (bool) out;
+    }
+
+    // sRGB through linear RGB and XYZ (D65) to CIELAB
+    static void toLab(const unsigned char *rgb, float *lab)
+    {
+        static float linear[256];
+        static bool initialized = false;
+        if (!initialized) {
+            for (int i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            initialized = true;
+        }
+        float r = linear[rgb[0]], g = linear[rgb[1]], b = linear[rgb[2]];
+        float xyz[3] = {
+                (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+                0.2126f * r + 0.7152f * g + 0.0722f * b,
+                (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f
+        };
+        for (float &t : xyz)
+            t = t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+        lab[0] = 116.0f * xyz[1] - 16.0f;
+        lab[1] = 500.0f * (xyz[0] - xyz[1]);
+        lab[2] = 200.0f * (xyz[1] - xyz[2]);
+    }
+
+    static double deltaE(const unsigned char *a, const unsigned char *b)
+    {
+        if (a[0] == b[0] && a[1] == b[1] && a[2] == b[2])
+            return 0.0;
+        float labA[3], labB[3];
+        toLab(a, labA);
+        toLab(b, labB);
+        return std::sqrt((labA[0] - labB[0]) * (labA[0] - labB[0]) + (labA[1] - labB[1]) * (labA[1] - labB[1]) +
+                         (labA[2] - labB[2]) * (labA[2] - labB[2]));
+    }
+};
+
+#endif //PROJECT_BASE_REGRESSIONSUITE_H
@@ -0,0 +1,144 @@
+#ifndef PROJECT_BASE_SCENE_H
+#define PROJECT_BASE_SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class Model;
+
+// The entities of the scene, stored as structure of arrays: every component is an array indexed by entity,
+// so a pass that reads one component (culling and sorting read world matrices, an instanced upload copies
+// them) walks contiguous memory and loads nothing else.
+//
+// Transforms form a hierarchy: an entity's world matrix is its parent's world matrix times its local one.
+// An entity can only be created after its parent, so walking the arrays in order visits every parent before
+// its children and Update() is a single pass. SetLocal marks an entity dirty; Update recomputes the world
+// (and normal) matrix of every dirty entity and of everything below it, and leaves the rest alone at the
+// cost of two flag tests. Changed(entity) then tells which world matrices this update touched.
+class Scene {
+public:
+    typedef unsigned int Entity;
+    static const Entity NONE = ~0u;
+
+    // model is NULL for an entity that only groups or carries others
+    Entity Create(Entity parent = NONE, const glm::mat4 &transform = glm::mat4(1.0f), Model *model = NULL,
+                  float materialShininess = 0.0f)
+    {
+        Entity entity = parents.size();
+        parents.push_back(parent);
+        local.push_back(transform);
+        world.push_back(transform);
+        normal.push_back(glm::mat3(1.0f));
+        localDirty.push_back(1);
+        worldChanged.push_back(0);
+        models.push_back(model);
+        shininess.push_back(materialShininess);
+        return entity;
+    }
+
+    // safe from several threads at once, as long as each sets different entities
+    void SetLocal(Entity entity, const glm::mat4 &transform)
+    {
+        local[entity] = transform;
+        localDirty[entity] = 1;
+    }
+
+    // recomputes the world matrices of the dirty subtrees, returns how many it recomputed
+    unsigned int Update()
+    {
+        unsigned int recomputed = 0;
+        for (Entity entity = 0; entity < parents.size(); entity++) {
+            Entity parent = parents[entity];
+            uint8_t changed = localDirty[entity] | (parent != NONE ? worldChanged[parent] : 0);
+            worldChanged[entity] = changed;
+            if (!changed)
+                continue;
+            localDirty[entity] = 0;
+            world[entity] = parent != NONE ? world[parent] * local[entity] : local[entity];
+            // the inverse transpose of the upper 3x3, keeps normals perpendicular under non-uniform scale
+            normal[entity] = glm::transpose(glm::inverse(glm::mat3(world[entity])));
+            recomputed++;
+        }
+        return recomputed;
+    }
+
+    void Clear()
+    {
+        parents.clear();
+        local.clear();
+        world.clear();
+        normal.clear();
+        localDirty.clear();
+        worldChanged.clear();
+        models.clear();
+        shininess.clear();
+    }
+
+    unsigned int Size() const
+    {
+        return parents.size();
+    }
+
+    Entity Parent(Entity entity) const
+    {
+        return parents[entity];
+    }
+
+    const glm::mat4 &Local(Entity entity) const
+    {
+        return local[entity];
+    }
+
+    const glm::mat4 &World(Entity entity) const
+    {
+        return world[entity];
+    }
+
+    // world space, computed once per entity instead of once per vertex
+    const glm::mat3 &NormalMatrix(Entity entity) const
+    {
+        return normal[entity];
+    }
+
+    Model *GetModel(Entity entity) const
+    {
+        return models[entity];
+    }
+
+    float Shininess(Entity entity) const
+    {
+        return shininess[entity];
+    }
+
+    // whether the last Update recomputed the entity's world matrix
+    bool Changed(Entity entity) const
+    {
+        return worldChanged[entity] != 0;
+    }
+
+    // the component arrays, for passes over every entity
+    const std::vector<glm::mat4> &WorldMatrices() const
+    {
+        return world;
+    }
+
+    const std::vector<Model *> &Models() const
+    {
+        return models;
+    }
+
+private:
+    std::vector<Entity> parents;
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat3> normal;
+    std::vector<uint8_t> localDirty;   // set by SetLocal, cleared by Update
+    std::vector<uint8_t> worldChanged; // recomputed by the last Update
+    std::vector<Model *> models;
+    std::vector<float> shininess;
+};
+
+#endif //PROJECT_BASE_SCENE_H
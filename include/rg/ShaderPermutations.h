@@ -0,0 +1,93 @@
+#ifndef PROJECT_BASE_SHADERPERMUTATIONS_H
+#define PROJECT_BASE_SHADERPERMUTATIONS_H
+
+#include <learnopengl/shader.h>
+#include <rg/ShaderPreprocessor.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Feature switches a shader is specialized for. Each one becomes a #define, so the shader tests it with
+// #if/#ifdef and a permutation without the feature has none of its code; counts become constants the
+// compiler can unroll loops over.
+//   NORMAL_MAPS, AMBIENT_OCCLUSION, INSTANCING - defined when enabled
+//   SAMPLE_COUNT                               - the number of samples, left undefined when 0
+struct ShaderFeatures {
+    bool normalMaps = false;
+    bool ambientOcclusion = false;
+    bool instancing = false;
+    unsigned int sampleCount = 0;
+
+    ShaderDefines Defines() const
+    {
+        ShaderDefines defines;
+        if (normalMaps)
+            defines.push_back({ "NORMAL_MAPS", "" });
+        if (ambientOcclusion)
+            defines.push_back({ "AMBIENT_OCCLUSION", "" });
+        if (instancing)
+            defines.push_back({ "INSTANCING", "" });
+        if (sampleCount > 0)
+            defines.push_back({ "SAMPLE_COUNT", std::to_string(sampleCount) });
+        return defines;
+    }
+
+    // the switches packed into one number, the count above the flags
+    uint32_t Key() const
+    {
+        return (normalMaps ? 1u : 0u) | (ambientOcclusion ? 2u : 0u) | (instancing ? 4u : 0u) | sampleCount << 3;
+    }
+};
+
+// The programs built from one set of stages, one per combination of features that has been asked for.
+// Get builds a permutation the first time it's needed (its binary goes through the program cache like any
+// other program) and hands out the same Shader afterwards, so the pointers stay valid as long as this lives.
+// The initializer runs once on every new permutation, for what would otherwise be done once per program at
+// startup: sampler units, constant uniforms, registering it for hot reload. Inside a ShaderBatch a new
+// permutation is only submitted, and its initializer runs when the batch finishes.
+class ShaderPermutations {
+public:
+    typedef std::function<void(Shader &)> Initializer;
+
+    explicit ShaderPermutations(const std::vector<Shader::Stage> &stages, Initializer initializer = Initializer())
+        : stages(stages), initializer(initializer)
+    {
+    }
+
+    // the initializer only sees permutations built after it's set
+    void SetInitializer(Initializer function)
+    {
+        initializer = function;
+    }
+
+    Shader &Get(const ShaderFeatures &features)
+    {
+        std::unique_ptr<Shader> &permutation = permutations[features.Key()];
+        if (!permutation) {
+            permutation.reset(new Shader(stages, features.Defines()));
+            Shader *shader = permutation.get();
+            Initializer function = initializer;
+            if (function && ShaderBatch::Current())
+                ShaderBatch::Current()->OnFinish([shader, function]() { function(*shader); });
+            else if (function)
+                function(*shader);
+        }
+        return *permutation;
+    }
+
+    unsigned int Count() const
+    {
+        return permutations.size();
+    }
+
+private:
+    std::vector<Shader::Stage> stages;
+    Initializer initializer;
+    std::map<uint32_t, std::unique_ptr<Shader>> permutations;
+};
+
+#endif //PROJECT_BASE_SHADERPERMUTATIONS_H
@@ -0,0 +1,120 @@
+#ifndef PROJECT_BASE_SHADERPREPROCESSOR_H
+#define PROJECT_BASE_SHADERPREPROCESSOR_H
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// name and value of a #define injected into a shader; an empty value defines just the name
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// What GLSL leaves to the application: `#include "file"` (relative to the including file) is replaced by the
+// file's contents, and the defines are inserted right after #version so every line of the shader sees them.
+// A file is included once per shader, later includes of it are dropped, which also ends include cycles.
+// #line directives keep the driver's error messages pointing at the right line; the source string number in
+// them is the file's index in `files`, the shader itself being 0.
+class ShaderPreprocessor {
+public:
+    // files: filled with the shader and everything it includes, for hot reload to know what to watch
+    static std::string Process(const std::string &path, const ShaderDefines &defines,
+                               std::vector<std::string> &files, bool &ok)
+    {
+        files.clear();
+        ok = true;
+        std::string source;
+        if (!read(path, source)) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            ok = false;
+            return "";
+        }
+        files.push_back(path);
+        std::istringstream lines(source);
+        std::string line, output, defineLines;
+        for (const std::pair<std::string, std::string> &define : defines)
+            defineLines += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+        unsigned int number = 0;
+        bool versionSeen = false;
+        while (std::getline(lines, line)) {
+            number++;
+            if (!versionSeen && line.compare(0, 8, "#version") == 0) {
+                output += line + "\n" + defineLines + "#line " + std::to_string(number + 1) + " 0\n";
+                versionSeen = true;
+                continue;
+            }
+            std::string include;
+            if (includePath(line, include)) {
+                output += expand(directory(path) + include, files, ok) + "#line " + std::to_string(number + 1) + " 0\n";
+                continue;
+            }
+            output += line + "\n";
+        }
+        if (!versionSeen)
+            output = defineLines + output;
+        return output;
+    }
+
+private:
+    static bool read(const std::string &path, std::string &source)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::stringstream stream;
+        stream << file.rdbuf();
+        source = stream.str();
+        return true;
+    }
+
+    static std::string directory(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    // true for `#include "file"` (leading whitespace allowed), file gets the quoted path
+    static bool includePath(const std::string &line, std::string &file)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            return false;
+        size_t open = line.find('"', start + 8), close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::cout << "ERROR::SHADER::BAD_INCLUDE: " << line << std::endl;
+            return false;
+        }
+        file = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    static std::string expand(const std::string &path, std::vector<std::string> &files, bool &ok)
+    {
+        for (const std::string &included : files)
+            if (included == path)
+                return "";
+        std::string source;
+        if (!read(path, source)) {
+            std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << path << std::endl;
+            ok = false;
+            return "";
+        }
+        unsigned int index = files.size();
+        files.push_back(path);
+        std::istringstream lines(source);
+        std::string line, output = "#line 1 " + std::to_string(index) + "\n", include;
+        unsigned int number = 0;
+        while (std::getline(lines, line)) {
+            number++;
+            if (includePath(line, include))
+                output += expand(directory(path) + include, files, ok) + "#line " + std::to_string(number + 1) +
+                          " " + std::to_string(index) + "\n";
+            else
+                output += line + "\n";
+        }
+        return output;
+    }
+};
+
+#endif //PROJECT_BASE_SHADERPREPROCESSOR_H
@@ -0,0 +1,260 @@
+#ifndef PROJECT_BASE_SHADERWATCHER_H
+#define PROJECT_BASE_SHADERWATCHER_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Live shader reload. A thread watches the shader directory with inotify and rebuilds every watched program
+// that uses a changed file (a stage or anything it #includes) on a context shared with the render context, so
+// compiling never stalls a frame; bindContext(true) makes that context current on the thread and
+// bindContext(false) releases it at the end.
+// Poll() swaps finished programs in between frames: the old program's uniforms are copied into the new one,
+// the new ID takes the old one's place and the old program is deleted. A program that fails to compile or
+// link is dropped with its log printed, and the old one stays active.
+//
+// Editors save with several writes or a rename, so events are collected until the directory has been quiet
+// for DEBOUNCE_MS before anything is rebuilt. Outside Linux Start() fails and nothing is watched.
+class ShaderWatcher {
+public:
+    typedef std::function<void(bool)> BindContext;
+
+    static const int DEBOUNCE_MS = 50;
+
+    ~ShaderWatcher()
+    {
+        Stop();
+    }
+
+    // safe to call while the watcher runs, programs built later (permutations) can be added any time
+    void Watch(Shader *shader)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shaders.push_back({ shader, shader->Files() });
+    }
+
+    bool Start(const std::string &directory, BindContext bindContext)
+    {
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0 || inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cout << "SHADER_WATCHER::CANNOT_WATCH: " << directory << std::endl;
+            if (descriptor >= 0)
+                close(descriptor);
+            descriptor = -1;
+            return false;
+        }
+        running = true;
+        thread = std::thread(&ShaderWatcher::run, this, bindContext);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Stop()
+    {
+        if (!thread.joinable())
+            return;
+        running = false;
+        thread.join();
+#ifdef __linux__
+        close(descriptor);
+        descriptor = -1;
+#endif
+        // programs that were rebuilt but never swapped in
+        for (const Rebuilt &rebuilt : finished)
+            glDeleteProgram(rebuilt.program);
+        finished.clear();
+    }
+
+    // call between frames on the render thread
+    void Poll()
+    {
+        std::vector<Rebuilt> swaps;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            swaps.swap(finished);
+        }
+        for (const Rebuilt &rebuilt : swaps) {
+            copyUniforms(rebuilt.shader->ID, rebuilt.program);
+            glDeleteProgram(rebuilt.shader->ID);
+            rebuilt.shader->ID = rebuilt.program;
+            std::cout << "Shader reloaded: " << describe(*rebuilt.shader) << " in " << rebuilt.milliseconds
+                      << " ms" << std::endl;
+        }
+    }
+
+private:
+    struct Rebuilt {
+        Shader *shader;
+        unsigned int program;
+        double milliseconds;
+    };
+
+    struct Watched {
+        Shader *shader;
+        std::vector<std::string> files; // of the newest build, the includes can change with the edit
+    };
+
+    std::vector<Watched> shaders;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::mutex mutex;
+    std::vector<Rebuilt> finished;
+    int descriptor = -1;
+
+    static std::string describe(const Shader &shader)
+    {
+        std::string names;
+        for (const Shader::Stage &stage : shader.Stages())
+            names += (names.empty() ? "" : " ") + stage.path;
+        return names;
+    }
+
+    static std::string fileName(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+#ifdef __linux__
+    // names of the files changed since the last call, empty when nothing happened within the timeout
+    std::set<std::string> changedFiles(int timeoutMs)
+    {
+        std::set<std::string> changed;
+        pollfd pending = { descriptor, POLLIN, 0 };
+        while (poll(&pending, 1, timeoutMs) > 0) {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + length;) {
+                    inotify_event *event = (inotify_event *) p;
+                    if (event->len > 0)
+                        changed.insert(event->name);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            // keep collecting until the editor is done writing
+            timeoutMs = DEBOUNCE_MS;
+        }
+        return changed;
+    }
+
+    void run(BindContext bindContext)
+    {
+        bindContext(true);
+        while (running) {
+            std::set<std::string> changed = changedFiles(100);
+            if (changed.empty())
+                continue;
+            std::vector<Watched> watched;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                watched = shaders;
+            }
+            for (size_t i = 0; i < watched.size(); i++) {
+                Shader *shader = watched[i].shader;
+                bool uses = false;
+                for (const std::string &file : watched[i].files)
+                    uses |= changed.count(fileName(file)) > 0;
+                if (!uses)
+                    continue;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                bool linked = false;
+                std::vector<std::string> files;
+                // stages and defines never change after construction, reading them here is safe
+                unsigned int program = Shader::Build(shader->Stages(), shader->Defines(), &linked, &files);
+                if (!linked) {
+                    std::cout << "Shader reload failed, keeping the old program: " << describe(*shader) << std::endl;
+                    glDeleteProgram(program);
+                    continue;
+                }
+                // the render context only sees a complete program once this context's commands are done
+                glFinish();
+                double milliseconds = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+                std::lock_guard<std::mutex> lock(mutex);
+                shaders[i].files = files;
+                finished.push_back({ shader, program, milliseconds });
+            }
+        }
+        bindContext(false);
+    }
+#endif
+
+    // re-applies the old program's uniform values by name, the new one may have added, removed or moved them
+    static void copyUniforms(GLuint from, GLuint to)
+    {
+        GLint count = 0, current = 0;
+        glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        glUseProgram(to);
+        for (GLint i = 0; i < count; i++) {
+            char name[256];
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(from, i, sizeof(name), NULL, &size, &type, name);
+            // uniforms in blocks have no location and live in buffers, nothing to copy
+            if (glGetUniformLocation(from, name) < 0)
+                continue;
+            // arrays are listed once as "name[0]", their elements are copied one by one
+            std::string base(name);
+            if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+                base.resize(base.size() - 3);
+            for (GLint element = 0; element < size; element++) {
+                std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+                GLint source = glGetUniformLocation(from, elementName.c_str());
+                GLint target = glGetUniformLocation(to, elementName.c_str());
+                if (source >= 0 && target >= 0)
+                    copyUniform(from, source, target, type);
+            }
+        }
+        glUseProgram((GLuint) current == from ? to : current);
+    }
+
+    static void copyUniform(GLuint from, GLint source, GLint target, GLenum type)
+    {
+        GLfloat f[16];
+        GLint i[4];
+        GLuint u[4];
+        switch (type) {
+            case GL_FLOAT: glGetUniformfv(from, source, f); glUniform1fv(target, 1, f); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glUniform2fv(target, 1, f); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glUniform3fv(target, 1, f); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glUniform4fv(target, 1, f); break;
+            case GL_FLOAT_MAT2: glGetUniformfv(from, source, f); glUniformMatrix2fv(target, 1, GL_FALSE, f); break;
+            case GL_FLOAT_MAT3: glGetUniformfv(from, source, f); glUniformMatrix3fv(target, 1, GL_FALSE, f); break;
+            case GL_FLOAT_MAT4: glGetUniformfv(from, source, f); glUniformMatrix4fv(target, 1, GL_FALSE, f); break;
+            case GL_INT_VEC2:
+            case GL_BOOL_VEC2: glGetUniformiv(from, source, i); glUniform2iv(target, 1, i); break;
+            case GL_INT_VEC3:
+            case GL_BOOL_VEC3: glGetUniformiv(from, source, i); glUniform3iv(target, 1, i); break;
+            case GL_INT_VEC4:
+            case GL_BOOL_VEC4: glGetUniformiv(from, source, i); glUniform4iv(target, 1, i); break;
+            case GL_UNSIGNED_INT: glGetUniformuiv(from, source, u); glUniform1uiv(target, 1, u); break;
+            case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, u); glUniform2uiv(target, 1, u); break;
+            case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, u); glUniform3uiv(target, 1, u); break;
+            case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, u); glUniform4uiv(target, 1, u); break;
+            // int, bool and every sampler and image type, whose value is a unit
+            default: glGetUniformiv(from, source, i); glUniform1iv(target, 1, i); break;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_SHADERWATCHER_H
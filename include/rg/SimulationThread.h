@@ -0,0 +1,204 @@
+#ifndef PROJECT_BASE_SIMULATIONTHREAD_H
+#define PROJECT_BASE_SIMULATIONTHREAD_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/camera.h>
+#include <rg/CpuProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// What the simulation reads from the input devices. The held keys are sampled by the render thread every
+// frame and hold until the next sample; mouse and scroll movement add up until a step consumes them, so none
+// of it is lost when several frames fall into one step or several steps into one frame.
+struct SimulationInput {
+    bool forward = false, backward = false, left = false, right = false;
+    int shipTurn = 0;       // the ship rolls while turning, -1, 0 or 1
+    float shipTilt = 0.0f;  // and tilts while moving, in degrees
+    float mouseX = 0.0f, mouseY = 0.0f;
+    float scroll = 0.0f;
+};
+
+// The world the simulation owns: the camera and the ship. The rock orbits and the lights are functions of
+// time, the renderer builds them from `time`.
+struct SceneState {
+    static constexpr float SHIP_ROLL_SPEED = 60.0f; // degrees per second
+
+    Camera camera;
+    float shipRoll = 0.0f;
+    float shipTilt = 0.0f;
+    double time = 0.0;
+
+    void Step(const SimulationInput &input, float step)
+    {
+        if (input.forward)
+            camera.ProcessKeyboard(FORWARD, step);
+        if (input.backward)
+            camera.ProcessKeyboard(BACKWARD, step);
+        if (input.left)
+            camera.ProcessKeyboard(LEFT, step);
+        if (input.right)
+            camera.ProcessKeyboard(RIGHT, step);
+        camera.ProcessMouseMovement(input.mouseX, input.mouseY);
+        camera.ProcessMouseScroll(input.scroll);
+        shipRoll += input.shipTurn * SHIP_ROLL_SPEED * step;
+        shipTilt = input.shipTilt;
+        time += step;
+    }
+
+    // between two states, alpha 0 is a and 1 is b; the tilt snaps like the input that sets it
+    static SceneState Interpolate(const SceneState &a, const SceneState &b, float alpha)
+    {
+        SceneState state = b;
+        state.camera.Position = glm::mix(a.camera.Position, b.camera.Position, alpha);
+        state.camera.Yaw = glm::mix(a.camera.Yaw, b.camera.Yaw, alpha);
+        state.camera.Pitch = glm::mix(a.camera.Pitch, b.camera.Pitch, alpha);
+        state.camera.Zoom = glm::mix(a.camera.Zoom, b.camera.Zoom, alpha);
+        // a zero mouse offset recomputes the camera vectors from the angles
+        state.camera.ProcessMouseMovement(0.0f, 0.0f);
+        state.shipRoll = glm::mix(a.shipRoll, b.shipRoll, alpha);
+        state.time = a.time + (b.time - a.time) * alpha;
+        return state;
+    }
+};
+
+// Runs the simulation at a fixed rate on its own thread, apart from rendering. Every step is published as an
+// immutable snapshot, the states before and after it, through a triple buffer: the simulation always has a
+// slot of its own to write, the renderer always has a complete snapshot to read, and neither ever waits for
+// the other. A slow frame only means snapshots are skipped; a slow step only means the renderer draws the
+// newest one again, held at the end of its interpolation. Like FrameClock, a stall longer than MAX_CATCH_UP
+// is skipped instead of simulated.
+//
+// The render thread reads the world with Current() and hands over input with SetHeldInput, AddMouseMovement
+// and AddScroll; the state passed to Start() is the simulation's from then on.
+class SimulationThread {
+public:
+    static constexpr double MAX_CATCH_UP = 0.25;
+
+    explicit SimulationThread(double fixedStep = 1.0 / 60.0) : fixedStep(fixedStep) {}
+
+    ~SimulationThread()
+    {
+        Stop();
+    }
+
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    void Start(const SceneState &initial)
+    {
+        if (thread.joinable())
+            return;
+        for (Snapshot &snapshot : snapshots)
+            snapshot = { initial, initial, now() };
+        ready = 2;
+        back = 0;
+        front = 1;
+        running = true;
+        thread = std::thread(&SimulationThread::run, this, initial);
+    }
+
+    void Stop()
+    {
+        if (!thread.joinable())
+            return;
+        running = false;
+        thread.join();
+    }
+
+    bool Running() const
+    {
+        return thread.joinable();
+    }
+
+    // render thread: the world at this instant, interpolated within the newest step
+    SceneState Current()
+    {
+        if (ready.load() & FRESH)
+            front = ready.exchange(front) & SLOT;
+        const Snapshot &snapshot = snapshots[front];
+        float alpha = (float) std::min(1.0, std::max(0.0, (now() - snapshot.published) / fixedStep));
+        return SceneState::Interpolate(snapshot.previous, snapshot.current, alpha);
+    }
+
+    void SetHeldInput(const SimulationInput &held)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.forward = held.forward;
+        input.backward = held.backward;
+        input.left = held.left;
+        input.right = held.right;
+        input.shipTurn = held.shipTurn;
+        input.shipTilt = held.shipTilt;
+    }
+
+    void AddMouseMovement(float x, float y)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.mouseX += x;
+        input.mouseY += y;
+    }
+
+    void AddScroll(float y)
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.scroll += y;
+    }
+
+private:
+    struct Snapshot {
+        SceneState previous, current;
+        double published; // when the step finished, in now() seconds
+    };
+    // `ready` holds the slot of the newest snapshot, FRESH until the renderer takes it
+    static const unsigned int SLOT = 3, FRESH = 4;
+
+    double fixedStep;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    Snapshot snapshots[3];
+    std::atomic<unsigned int> ready{ 2 };
+    unsigned int back = 0;  // the simulation's slot
+    unsigned int front = 1; // the renderer's slot
+    std::mutex inputMutex;
+    SimulationInput input;
+
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void run(SceneState state)
+    {
+        RG_PROFILE_THREAD("simulation");
+        double next = now();
+        while (running) {
+            SimulationInput stepInput;
+            {
+                std::lock_guard<std::mutex> lock(inputMutex);
+                stepInput = input;
+                input.mouseX = input.mouseY = input.scroll = 0.0f;
+            }
+            Snapshot &snapshot = snapshots[back];
+            snapshot.previous = state;
+            {
+                RG_PROFILE_ZONE("simulation step");
+                state.Step(stepInput, (float) fixedStep);
+            }
+            snapshot.current = state;
+            snapshot.published = now();
+            back = ready.exchange(back | FRESH) & SLOT;
+
+            next += fixedStep;
+            if (now() - next > MAX_CATCH_UP)
+                next = now();
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(next))));
+        }
+    }
+};
+
+#endif //PROJECT_BASE_SIMULATIONTHREAD_H
@@ -0,0 +1,208 @@
+#ifndef PROJECT_BASE_STARTUPREPORT_H
+#define PROJECT_BASE_STARTUPREPORT_H
+
+#include <rg/Json.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Where the time to the first frame goes. main() splits startup into phases with BeginPhase; the loaders
+// (Shader, Model, TextureFromFile, loadTexture, loadCubemap) open a scoped Asset for every file they turn into
+// GL objects and report the bytes they read from disk and hand to GL. Assets nest (a model's textures are
+// assets of their own inside it) and every byte is counted once, on the innermost open asset.
+// Finish() ends the report at the first presented frame; assets loaded later aren't recorded.
+// Loaders may run on worker threads: every thread has its own stack of open assets, so bytes land on the
+// asset the reporting thread opened, and an asset opened on a worker has no parent from another thread.
+//
+// Upload times are what the driver spends inside the calls, a driver may still be copying afterwards.
+class StartupReport {
+public:
+    class Asset {
+    public:
+        Asset(const char *kind, const std::string &name)
+        {
+            std::lock_guard<std::mutex> lock(instance().mutex);
+            if (instance().finished)
+                return;
+            index = instance().assets.size();
+            instance().assets.push_back({ kind, name, currentPhase(), open().empty() ? -1 : open().back(),
+                                          Now(), 0.0, 0, 0 });
+            open().push_back(index);
+        }
+
+        ~Asset()
+        {
+            if (index < 0)
+                return;
+            std::lock_guard<std::mutex> lock(instance().mutex);
+            instance().assets[index].end = Now();
+            open().pop_back();
+        }
+
+        Asset(const Asset &) = delete;
+        Asset &operator=(const Asset &) = delete;
+
+    private:
+        int index = -1;
+    };
+
+    // seconds since the report's epoch, the first call into it
+    static double Now()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // ends the running phase and starts the next one
+    static void BeginPhase(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        if (instance().finished)
+            return;
+        double now = Now();
+        if (!instance().phases.empty())
+            instance().phases.back().end = now;
+        instance().phases.push_back({ name, now, now, 0, 0 });
+    }
+
+    static void AddBytesRead(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        if (instance().finished)
+            return;
+        if (!open().empty())
+            instance().assets[open().back()].bytesRead += bytes;
+        if (!instance().phases.empty())
+            instance().phases.back().bytesRead += bytes;
+    }
+
+    static void AddBytesUploaded(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        if (instance().finished)
+            return;
+        if (!open().empty())
+            instance().assets[open().back()].bytesUploaded += bytes;
+        if (!instance().phases.empty())
+            instance().phases.back().bytesUploaded += bytes;
+    }
+
+    // ends the last phase; the total is the time to this call
+    static void Finish()
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        if (instance().finished)
+            return;
+        instance().total = Now();
+        if (!instance().phases.empty())
+            instance().phases.back().end = instance().total;
+        instance().finished = true;
+    }
+
+    static bool Finished()
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        return instance().finished;
+    }
+
+    // 0 when the file can't be stat'ed
+    static size_t FileSize(const std::string &path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? (size_t) info.st_size : 0;
+    }
+
+    // phase names and durations in seconds, followed by "total"
+    static std::vector<std::pair<std::string, double>> Phases()
+    {
+        std::vector<std::pair<std::string, double>> result;
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        for (const Phase &phase : instance().phases)
+            result.push_back({ phase.name, phase.end - phase.start });
+        result.push_back({ "total", instance().finished ? instance().total : Now() });
+        return result;
+    }
+
+    static void Write(std::ostream &out)
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        const StartupReport &report = instance();
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"total_ms\": " << (report.finished ? report.total : Now()) * 1000.0 << ",\n";
+        out << "  \"phases\": [";
+        for (size_t i = 0; i < report.phases.size(); i++) {
+            const Phase &phase = report.phases[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << rg::escapeJSON(phase.name) << "\", \"start_ms\": "
+                << phase.start * 1000.0 << ", \"ms\": " << (phase.end - phase.start) * 1000.0
+                << ", \"bytes_read\": " << phase.bytesRead << ", \"bytes_uploaded\": " << phase.bytesUploaded << "}";
+        }
+        out << "\n  ],\n  \"assets\": [";
+        for (size_t i = 0; i < report.assets.size(); i++) {
+            const AssetRecord &asset = report.assets[i];
+            out << (i ? "," : "") << "\n    {\"id\": " << i << ", \"parent\": " << asset.parent << ", \"kind\": \""
+                << asset.kind << "\", \"name\": \"" << rg::escapeJSON(asset.name) << "\", \"phase\": \""
+                << rg::escapeJSON(asset.phase) << "\", \"start_ms\": " << asset.start * 1000.0 << ", \"ms\": "
+                << (asset.end - asset.start) * 1000.0 << ", \"bytes_read\": " << asset.bytesRead
+                << ", \"bytes_uploaded\": " << asset.bytesUploaded << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    static bool Write(const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        Write(out);
+        return (bool) out;
+    }
+
+private:
+    struct Phase {
+        std::string name;
+        double start, end;
+        size_t bytesRead, bytesUploaded;
+    };
+
+    struct AssetRecord {
+        const char *kind;
+        std::string name;
+        std::string phase;
+        int parent;
+        double start, end;
+        size_t bytesRead, bytesUploaded;
+    };
+
+    std::vector<Phase> phases;
+    std::vector<AssetRecord> assets;
+    double total = 0.0;
+    bool finished = false;
+    std::mutex mutex;
+
+    static StartupReport &instance()
+    {
+        static StartupReport report;
+        return report;
+    }
+
+    // indexes of the assets the calling thread has open, innermost last
+    static std::vector<int> &open()
+    {
+        static thread_local std::vector<int> assets;
+        return assets;
+    }
+
+    static std::string currentPhase()
+    {
+        return instance().phases.empty() ? "" : instance().phases.back().name;
+    }
+};
+
+#endif //PROJECT_BASE_STARTUPREPORT_H
@@ -0,0 +1,257 @@
+#ifndef PROJECT_BASE_UPLOADRING_H
+#define PROJECT_BASE_UPLOADRING_H
+
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+#include <rg/GpuMemory.h>
+#include <imgui.h>
+
+#include <algorithm>
+#include <vector>
+
+// Per-frame dynamic data (uniform blocks, storage buffers, instance attributes) written straight into GPU
+// visible memory. With ARB_buffer_storage one immutable buffer stays mapped for the whole run and is split
+// into FRAMES regions, one per frame in flight: BeginFrame moves to the next region and waits on the fence
+// EndFrame put behind it FRAMES frames ago, which has normally signalled long since, so the CPU writes
+// while the GPU still reads the other regions and the driver never copies or renames anything. The mapping
+// is coherent by default; with coherent false it is flushed explicitly by Commit.
+//
+// Without buffer storage (GL 3.3) BeginFrame orphans the buffer instead and every allocation maps its range
+// unsynchronized; the driver hands out fresh storage once a frame and keeps the old one for the frames still
+// reading it.
+//
+// Allocate always succeeds: a frame that outgrows its region moves to a buffer twice the size, and the old
+// one is deleted at the next BeginFrame, after every draw that reads it has been issued. Write an allocation
+// before the next Allocate and Commit before the GPU reads any of them.
+class UploadRing {
+public:
+    static const unsigned int FRAMES = 3;
+    static const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+    struct Allocation {
+        void *data;
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    explicit UploadRing(GLsizeiptr frameSize, bool persistent = rg::glCaps.bufferStorage, bool coherent = true)
+        : persistent(persistent && rg::glCaps.bufferStorage), coherent(coherent)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = std::max(alignment, 1);
+        if (rg::glCaps.computeShaders) {
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            storageAlignment = std::max(alignment, 1);
+        }
+        create(std::max<GLsizeiptr>(frameSize, 256));
+    }
+
+    UploadRing(const UploadRing &) = delete;
+    UploadRing &operator=(const UploadRing &) = delete;
+
+    // call before the first allocation of a frame
+    void BeginFrame()
+    {
+        for (GLuint old : retired) {
+            GpuMemory::ReleaseBuffer(old);
+            glDeleteBuffers(1, &old);
+        }
+        retired.clear();
+        frameBytes = 0;
+        if (!persistent) {
+            // orphaning: the storage the last frames read stays with them
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, frameSize, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            head = committed = 0;
+            return;
+        }
+        region = (region + 1) % FRAMES;
+        if (fences[region]) {
+            if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED) {
+                stalls++;
+                glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        head = committed = region * frameSize;
+    }
+
+    Allocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16)
+    {
+        GLintptr offset = alignUp(head, alignment);
+        if (offset + size > regionEnd()) {
+            grow(size + alignment);
+            offset = alignUp(head, alignment);
+        }
+        frameBytes += offset + size - head;
+        allocated = std::max(allocated, frameBytes);
+        head = offset + size;
+        if (persistent)
+            return { mapped + offset, buffer, offset, size };
+        // one mapping at a time, the previous allocation is written by now
+        Commit();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        void *data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mappedRange = true;
+        return { data, buffer, offset, size };
+    }
+
+    // aligned for glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    Allocation AllocateUniform(GLsizeiptr size)
+    {
+        return Allocate(size, uniformAlignment);
+    }
+
+    // aligned for glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ...), GL 4.3
+    Allocation AllocateStorage(GLsizeiptr size)
+    {
+        return Allocate(size, storageAlignment);
+    }
+
+    // makes everything written since the last Commit visible to the commands issued after it
+    void Commit()
+    {
+        if (!persistent) {
+            if (mappedRange) {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                mappedRange = false;
+            }
+        }
+        else if (!coherent && head > committed) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, committed, head - committed);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        committed = head;
+    }
+
+    // call after the last draw that reads this frame's allocations
+    void EndFrame()
+    {
+        Commit();
+        if (persistent)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLint UniformAlignment() const
+    {
+        return uniformAlignment;
+    }
+
+    bool Persistent() const
+    {
+        return persistent;
+    }
+
+    // bytes per frame, grows with the largest frame
+    GLsizeiptr FrameSize() const
+    {
+        return frameSize;
+    }
+
+    // the most a frame has used so far
+    GLsizeiptr Allocated() const
+    {
+        return allocated;
+    }
+
+    // frames that found their region still in use by the GPU
+    unsigned int Stalls() const
+    {
+        return stalls;
+    }
+
+    void DrawImGui() const
+    {
+        ImGui::SetNextWindowPos(ImVec2(1100.0f, 130.0f), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.6f);
+        ImGui::Begin("Dynamic uploads", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::Text("%s", persistent ? (coherent ? "persistent, coherent" : "persistent, flushed") : "orphaned");
+        ImGui::Text("%.1f of %.1f KB per frame, %u stalls", allocated / 1024.0, frameSize / 1024.0, stalls);
+        ImGui::End();
+    }
+
+private:
+    bool persistent;
+    bool coherent;
+    GLint uniformAlignment = 256;
+    GLint storageAlignment = 256;
+    GLuint buffer = 0;
+    char *mapped = NULL;
+    GLsizeiptr frameSize = 0;
+    unsigned int region = 0;
+    GLsync fences[FRAMES] = {};
+    GLintptr head = 0;
+    GLintptr committed = 0;
+    bool mappedRange = false;
+    GLsizeiptr frameBytes = 0;
+    GLsizeiptr allocated = 0;
+    unsigned int stalls = 0;
+    std::vector<GLuint> retired;
+
+    static GLintptr alignUp(GLintptr offset, GLsizeiptr alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    GLintptr regionStart() const
+    {
+        return persistent ? region * frameSize : 0;
+    }
+
+    GLintptr regionEnd() const
+    {
+        return regionStart() + frameSize;
+    }
+
+    void create(GLsizeiptr size)
+    {
+        frameSize = size;
+        GLsizeiptr bytes = persistent ? frameSize * FRAMES : frameSize;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | (coherent ? GL_MAP_COHERENT_BIT : 0);
+            glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, NULL, flags);
+            mapped = (char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes,
+                                               flags | (coherent ? 0 : GL_MAP_FLUSH_EXPLICIT_BIT));
+        }
+        else
+            glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        GpuMemory::TrackBuffer(buffer, GpuMemory::OTHER, "upload ring", bytes);
+    }
+
+    // moves the rest of the frame to a new buffer with room for `needed` more bytes
+    void grow(GLsizeiptr needed)
+    {
+        Commit();
+        if (persistent) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            // the new buffer has no frames in flight
+            for (GLsync &fence : fences) {
+                if (fence)
+                    glDeleteSync(fence);
+                fence = 0;
+            }
+        }
+        retired.push_back(buffer);
+        GLsizeiptr size = frameSize * 2;
+        while (size < needed)
+            size *= 2;
+        create(size);
+        head = committed = regionStart();
+    }
+};
+
+#endif //PROJECT_BASE_UPLOADRING_H
@@ -0,0 +1,9 @@
+// Per-draw data of the scene's objects, #included by the shaders drawScene draws with. The block has no
+// instance name, so its members read like plain uniforms; the CPU writes it into the upload ring once per
+// draw and binds that range at DRAW_DATA_BINDING (main.cpp) instead of setting uniforms one by one.
+layout (std140) uniform DrawData {
+    mat4 model;
+    // inverse transpose of mat3(model), in the space the shader lights in, computed on the CPU
+    mat3 normalMatrix;
+    float shininess;
+};
@@ -0,0 +1,15 @@
+// Blinn-Phong terms shared by the forward and the deferred lighting, #included by the fragment shaders.
+// All vectors are normalized and point away from the surface.
+
+// diffuse factor (Lambert) of a light
+float lambert(vec3 normal, vec3 lightDir)
+{
+    return max(dot(normal, lightDir), 0.0);
+}
+
+// specular factor from the half vector between the light and the viewer
+float blinnPhong(vec3 normal, vec3 lightDir, vec3 viewDir, float shininess)
+{
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    return pow(max(dot(normal, halfwayDir), 0.0), shininess);
+}
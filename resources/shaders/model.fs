@@ -13,8 +13,6 @@ struct DirLight {
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
-
-    float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
@@ -24,15 +22,18 @@ uniform DirLight dirLight;
 uniform Material material;
 
 uniform vec3 viewPosition;
+
+#include "draw_data.glsl"
+#include "lighting.glsl"
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
+    float diff = lambert(normal, lightDir);
     // specular shading
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(viewDir, halfwayDir), 0.0), material.shininess);
+    float spec = blinnPhong(normal, lightDir, viewDir, shininess);
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
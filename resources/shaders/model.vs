@@ -7,14 +7,19 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// normalMatrix is world space here
+#include "draw_data.glsl"
+
+// matches depth_prepass.vs, the pre-pass depth has to be reproduced exactly
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#version 430 core
+// compute version of ssao.fs: every workgroup first loads the view-space depth of its tile plus an
+// apron into shared memory, so kernel taps that land near the pixel don't go back to the texture
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (r16f, binding = 0) uniform writeonly image2D ssaoOutput;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+
+uniform vec3 samples[256];
+uniform int kernelSize;
+
+// parameters, must match ssao.fs
+float radius = 0.5;
+float bias = 0.025;
+
+uniform mat4 projection;
+
+const int TILE_SIZE = 16;
+const int APRON = 8;
+const int SHARED_SIZE = TILE_SIZE + 2 * APRON;
+shared float tileDepth[SHARED_SIZE * SHARED_SIZE];
+
+void main()
+{
+    ivec2 size = textureSize(gPosition, 0);
+    ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * TILE_SIZE - APRON;
+    for (int i = int(gl_LocalInvocationIndex); i < SHARED_SIZE * SHARED_SIZE; i += TILE_SIZE * TILE_SIZE)
+    {
+        ivec2 texel = clamp(tileOrigin + ivec2(i % SHARED_SIZE, i / SHARED_SIZE), ivec2(0), size - 1);
+        tileDepth[i] = texelFetch(gPosition, texel, 0).z;
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= size.x || pixel.y >= size.y)
+        return;
+
+    // get input for SSAO algorithm; pixels the geometry pass didn't cover stay unoccluded
+    vec3 fragPos = texelFetch(gPosition, pixel, 0).xyz;
+    if (fragPos == vec3(0.0))
+    {
+        imageStore(ssaoOutput, pixel, vec4(1.0));
+        return;
+    }
+    vec3 normal = normalize(texelFetch(gNormal, pixel, 0).rgb);
+    // the 4x4 noise texture tiles once per 4x4 pixel block, which the 4x4 blur then averages out
+    vec3 randomVec = normalize(texelFetch(texNoise, pixel & 3, 0).xyz);
+    // create TBN change-of-basis matrix: from tangent-space to view-space
+    vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+    // iterate over the sample kernel and calculate occlusion factor
+    float occlusion = 0.0;
+    for(int i = 0; i < kernelSize; ++i)
+    {
+        // get sample position
+        vec3 samplePos = TBN * samples[i]; // from tangent to view-space
+        samplePos = fragPos + samplePos * radius;
+
+        // project sample position (to sample texture) (to get position on screen/texture)
+        vec4 offset = vec4(samplePos, 1.0);
+        offset = projection * offset; // from view to clip-space
+        offset.xyz /= offset.w; // perspective divide
+        offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
+
+        // get sample depth, from the shared tile when the tap lands inside it
+        ivec2 local = ivec2(floor(offset.xy * vec2(size))) - tileOrigin;
+        float sampleDepth;
+        if (all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(SHARED_SIZE))))
+            sampleDepth = tileDepth[local.y * SHARED_SIZE + local.x];
+        else
+            sampleDepth = texture(gPosition, offset.xy).z;
+
+        // range check & accumulate
+        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+        occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
+    }
+    occlusion = 1.0 - (occlusion / kernelSize);
+
+    imageStore(ssaoOutput, pixel, vec4(occlusion));
+}
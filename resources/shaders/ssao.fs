@@ -7,16 +7,17 @@ uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
-uniform vec3 samples[64];
+// SAMPLE_COUNT is set per permutation, a constant loop count lets the compiler unroll the kernel
+#ifndef SAMPLE_COUNT
+#define SAMPLE_COUNT 64
+#endif
+const int kernelSize = SAMPLE_COUNT;
+uniform vec3 samples[kernelSize];
 
 // parameters (you'd probably want to use them as uniforms to more easily tweak the effect)
-int kernelSize = 64;
 float radius = 0.5;
 float bias = 0.025;
 
-// tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(800.0/4.0, 600.0/4.0);
-
 uniform mat4 projection;
 
 void main()
@@ -24,7 +25,8 @@ void main()
     // get input for SSAO algorithm
     vec3 fragPos = texture(gPosition, TexCoords).xyz;
     vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
-    vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
+    // the 4x4 noise texture tiles once per 4x4 pixel block, which the 4x4 blur then averages out
+    vec3 randomVec = normalize(texelFetch(texNoise, ivec2(gl_FragCoord.xy) & 3, 0).xyz);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
@@ -50,7 +52,7 @@ void main()
         float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
         occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
     }
-    occlusion = 1.0 - (occlusion / kernelSize);
+    occlusion = 1.0 - (occlusion / float(kernelSize));
 
     FragColor = occlusion;
 }
\ No newline at end of file
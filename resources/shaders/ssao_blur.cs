@@ -0,0 +1,41 @@
+#version 430 core
+// compute version of ssao_blur.fs: the 4x4 box filter reads its taps from a shared tile of AO values
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout (r16f, binding = 0) uniform writeonly image2D ssaoBlurOutput;
+
+uniform sampler2D ssaoInput;
+
+const int TILE_SIZE = 16;
+// the filter covers offsets -2..1
+const int APRON_BEFORE = 2;
+const int APRON_AFTER = 1;
+const int SHARED_SIZE = TILE_SIZE + APRON_BEFORE + APRON_AFTER;
+shared float tileOcclusion[SHARED_SIZE * SHARED_SIZE];
+
+void main()
+{
+    ivec2 size = textureSize(ssaoInput, 0);
+    ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * TILE_SIZE - APRON_BEFORE;
+    for (int i = int(gl_LocalInvocationIndex); i < SHARED_SIZE * SHARED_SIZE; i += TILE_SIZE * TILE_SIZE)
+    {
+        // clamp like the fragment version's CLAMP_TO_EDGE lookups
+        ivec2 texel = clamp(tileOrigin + ivec2(i % SHARED_SIZE, i / SHARED_SIZE), ivec2(0), size - 1);
+        tileOcclusion[i] = texelFetch(ssaoInput, texel, 0).r;
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= size.x || pixel.y >= size.y)
+        return;
+    ivec2 local = ivec2(gl_LocalInvocationID.xy) + APRON_BEFORE;
+    float result = 0.0;
+    for (int x = -2; x < 2; ++x)
+    {
+        for (int y = -2; y < 2; ++y)
+        {
+            result += tileOcclusion[(local.y + y) * SHARED_SIZE + local.x + x];
+        }
+    }
+    imageStore(ssaoBlurOutput, pixel, vec4(result / (4.0 * 4.0)));
+}
@@ -9,18 +9,25 @@ out vec3 Normal;
 
 uniform bool invertedNormals;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// normalMatrix is view space here, the inverse transpose of mat3(view * model)
+#include "draw_data.glsl"
+
 void main()
 {
     vec4 viewPos = view * model * vec4(aPos, 1.0);
     FragPos = viewPos.xyz;
     TexCoords = aTexCoords;
 
-    mat3 normalMatrix = transpose(inverse(mat3(view * model)));
+#ifdef NORMAL_MATRIX_PER_VERTEX
+    // the old way, only built for --normal-matrix-benchmark: a 3x3 inverse for every vertex
+    mat3 vertexNormalMatrix = transpose(inverse(mat3(view * model)));
+    Normal = vertexNormalMatrix * (invertedNormals ? -aNormal : aNormal);
+#else
     Normal = normalMatrix * (invertedNormals ? -aNormal : aNormal);
+#endif
 
     gl_Position = projection * viewPos;
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+
+// total taps per pixel are sliceCount * stepCount * 2 (both sides of every slice), about SAMPLE_COUNT;
+// set per permutation so the loops have constant bounds
+#ifndef SAMPLE_COUNT
+#define SAMPLE_COUNT 64
+#endif
+#if SAMPLE_COUNT >= 64
+const int sliceCount = 4;
+#else
+const int sliceCount = 2;
+#endif
+const int stepCount = max(1, SAMPLE_COUNT / (2 * sliceCount));
+
+// parameters (same radius as the hemisphere kernel so the passes are comparable)
+float radius = 0.5;
+
+const float PI = 3.14159265;
+const float HALF_PI = 1.57079633;
+
+uniform mat4 projection;
+
+// cosine-weighted visibility of the arc between the normal and horizon angle h
+float integrateArc(float h, float n)
+{
+    return 0.25 * (-cos(2.0 * h - n) + cos(n) + 2.0 * h * sin(n));
+}
+
+void main()
+{
+    vec3 fragPos = texture(gPosition, TexCoords).xyz;
+    // nothing was rendered here, leave it unoccluded
+    if (fragPos == vec3(0.0))
+    {
+        FragColor = 1.0;
+        return;
+    }
+    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    vec3 viewDir = normalize(-fragPos);
+    vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+    vec3 randomVec = texture(texNoise, TexCoords * noiseScale).xyz;
+    float rotation = atan(randomVec.y, randomVec.x);
+    float jitter = fract(randomVec.x * 0.5 + 0.5 + randomVec.y);
+
+    vec4 edge = projection * vec4(fragPos + vec3(radius, 0.0, 0.0), 1.0);
+    vec4 center = projection * vec4(fragPos, 1.0);
+    float radiusUV = abs(edge.x / edge.w - center.x / center.w) * 0.5;
+    vec2 stepUV = vec2(radiusUV / float(stepCount));
+    stepUV.y *= float(textureSize(gPosition, 0).x) / float(textureSize(gPosition, 0).y);
+
+    float visibility = 0.0;
+    for (int slice = 0; slice < sliceCount; ++slice)
+    {
+        float phi = PI * float(slice) / float(sliceCount) + rotation;
+        vec2 direction = vec2(cos(phi), sin(phi));
+        // slice plane through the view vector, project the normal into it
+        vec3 sliceDir = vec3(direction, 0.0);
+        vec3 orthoDir = sliceDir - dot(sliceDir, viewDir) * viewDir;
+        vec3 axis = normalize(cross(sliceDir, viewDir));
+        vec3 projNormal = normal - axis * dot(normal, axis);
+        float projLength = length(projNormal);
+        float cosN = clamp(dot(projNormal, viewDir) / max(projLength, 1e-4), 0.0, 1.0);
+        float n = sign(dot(orthoDir, projNormal)) * acos(cosN);
+
+        // find the maximum horizon on both sides of the slice
+        float horizonCos[2] = float[2](-1.0, -1.0);
+        for (int side = 0; side < 2; ++side)
+        {
+            float sideSign = side == 0 ? -1.0 : 1.0;
+            for (int s = 0; s < stepCount; ++s)
+            {
+                vec2 sampleUV = TexCoords + sideSign * direction * stepUV * (float(s) + jitter + 1.0);
+                vec3 samplePos = texture(gPosition, sampleUV).xyz;
+                if (samplePos == vec3(0.0))
+                    continue;
+                vec3 toSample = samplePos - fragPos;
+                float sampleDistance = length(toSample);
+                float falloff = clamp(1.0 - sampleDistance / radius, 0.0, 1.0);
+                float sampleCos = mix(-1.0, dot(toSample / sampleDistance, viewDir), falloff);
+                horizonCos[side] = max(horizonCos[side], sampleCos);
+            }
+        }
+        float h0 = n + max(-acos(horizonCos[0]) - n, -HALF_PI);
+        float h1 = n + min(acos(horizonCos[1]) - n, HALF_PI);
+        visibility += projLength * (integrateArc(h0, n) + integrateArc(h1, n));
+    }
+
+    FragColor = clamp(visibility / float(sliceCount), 0.0, 1.0);
+}
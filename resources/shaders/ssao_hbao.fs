@@ -0,0 +1,83 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+
+// total taps per pixel are numDirections * numSteps, about SAMPLE_COUNT; set per permutation so the
+// loops have constant bounds
+#ifndef SAMPLE_COUNT
+#define SAMPLE_COUNT 64
+#endif
+#if SAMPLE_COUNT >= 32
+const int numDirections = 8;
+#else
+const int numDirections = 4;
+#endif
+const int numSteps = max(1, SAMPLE_COUNT / numDirections);
+
+// parameters (same radius and bias as the hemisphere kernel so the passes are comparable)
+float radius = 0.5;
+float bias = 0.1;
+
+const float PI = 3.14159265;
+
+uniform mat4 projection;
+
+void main()
+{
+    vec3 fragPos = texture(gPosition, TexCoords).xyz;
+    // nothing was rendered here, leave it unoccluded
+    if (fragPos == vec3(0.0))
+    {
+        FragColor = 1.0;
+        return;
+    }
+    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    // tile noise texture over screen and use it to rotate directions and jitter the first step
+    vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+    vec3 randomVec = texture(texNoise, TexCoords * noiseScale).xyz;
+    float rotation = atan(randomVec.y, randomVec.x);
+    float jitter = fract(randomVec.x * 0.5 + 0.5 + randomVec.y);
+
+    // project the world-space radius to get the marching distance in texture space
+    vec4 edge = projection * vec4(fragPos + vec3(radius, 0.0, 0.0), 1.0);
+    vec4 center = projection * vec4(fragPos, 1.0);
+    float radiusUV = abs(edge.x / edge.w - center.x / center.w) * 0.5;
+    vec2 stepUV = vec2(radiusUV / float(numSteps));
+    stepUV.y *= float(textureSize(gPosition, 0).x) / float(textureSize(gPosition, 0).y);
+
+    float occlusion = 0.0;
+    for (int d = 0; d < numDirections; ++d)
+    {
+        float angle = 2.0 * PI * float(d) / float(numDirections) + rotation;
+        vec2 direction = vec2(cos(angle), sin(angle));
+        // march along the direction and keep the highest horizon above the tangent plane
+        float sinHorizon = sin(bias);
+        float horizonOcclusion = 0.0;
+        for (int s = 0; s < numSteps; ++s)
+        {
+            vec2 sampleUV = TexCoords + direction * stepUV * (float(s) + jitter + 1.0);
+            vec3 samplePos = texture(gPosition, sampleUV).xyz;
+            vec3 toSample = samplePos - fragPos;
+            float distanceSq = dot(toSample, toSample);
+            if (samplePos == vec3(0.0) || distanceSq > radius * radius)
+                continue;
+            float sinElevation = dot(normal, toSample) * inversesqrt(distanceSq);
+            if (sinElevation > sinHorizon)
+            {
+                // attenuate with distance so far-away horizons fade out smoothly
+                float falloff = 1.0 - distanceSq / (radius * radius);
+                horizonOcclusion += (sinElevation - sinHorizon) * falloff;
+                sinHorizon = sinElevation;
+            }
+        }
+        occlusion += horizonOcclusion;
+    }
+    occlusion = 1.0 - clamp(occlusion / float(numDirections), 0.0, 1.0);
+
+    FragColor = occlusion;
+}
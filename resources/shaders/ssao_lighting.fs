@@ -6,16 +6,25 @@ in vec2 TexCoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
+#ifdef AMBIENT_OCCLUSION
 uniform sampler2D ssao;
+#endif
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
+// clustered point lights, see rg/ClusteredLights.h for the layout
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndices;
+uniform vec2 clusterTileScale;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
 
-    float Linear;
-    float Quadratic;
-};
-uniform Light light;
+const ivec3 clusterDims = ivec3(16, 9, 24);
+
+// attenuation shared by all lights, windowed to zero at each light's radius
+uniform float lightLinear;
+uniform float lightQuadratic;
+
+#include "lighting.glsl"
 
 void main()
 {
@@ -23,25 +32,44 @@ void main()
     vec3 FragPos = texture(gPosition, TexCoords).rgb;
     vec3 Normal = texture(gNormal, TexCoords).rgb;
     vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
+#ifdef AMBIENT_OCCLUSION
     float AmbientOcclusion = texture(ssao, TexCoords).r;
+#else
+    float AmbientOcclusion = 1.0;
+#endif
 
     // then calculate lighting as usual
     vec3 ambient = vec3(0.3 * Diffuse * AmbientOcclusion);
     vec3 lighting  = ambient;
     vec3 viewDir  = normalize(-FragPos); // viewpos is (0.0.0)
-    // diffuse
-    vec3 lightDir = normalize(light.Position - FragPos);
-    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * light.Color;
-    // specular
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(Normal, halfwayDir), 0.0), 8.0);
-    vec3 specular = light.Color * spec;
-    // attenuation
-    float distance = length(light.Position - FragPos);
-    float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
-    diffuse *= attenuation;
-    specular *= attenuation;
-    lighting += diffuse + specular;
+
+    // find the cluster of this pixel; background pixels have no position and get no lights
+    uvec2 cluster = uvec2(0u);
+    if (FragPos.z < 0.0)
+    {
+        ivec2 tile = ivec2(gl_FragCoord.xy * clusterTileScale);
+        int slice = clamp(int(floor(log(-FragPos.z) * clusterSliceScale + clusterSliceBias)), 0, clusterDims.z - 1);
+        int clusterIndex = (slice * clusterDims.y + min(tile.y, clusterDims.y - 1)) * clusterDims.x + min(tile.x, clusterDims.x - 1);
+        cluster = texelFetch(clusterGrid, clusterIndex).xy;
+    }
+    for (uint i = 0u; i < cluster.y; ++i)
+    {
+        int lightIndex = int(texelFetch(lightIndices, int(cluster.x + i)).r);
+        vec4 positionRadius = texelFetch(lightData, lightIndex * 2);
+        vec3 lightColor = texelFetch(lightData, lightIndex * 2 + 1).rgb;
+        float distance = length(positionRadius.xyz - FragPos);
+        if (distance >= positionRadius.w)
+            continue;
+        // diffuse
+        vec3 lightDir = (positionRadius.xyz - FragPos) / distance;
+        vec3 diffuse = lambert(Normal, lightDir) * Diffuse * lightColor;
+        // specular
+        vec3 specular = lightColor * blinnPhong(Normal, lightDir, viewDir, 8.0);
+        // attenuation
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + lightLinear * distance + lightQuadratic * distance * distance);
+        lighting += (diffuse + specular) * attenuation;
+    }
 
     FragColor = vec4(lighting, 1.0);
-}
\ No newline at end of file
+}
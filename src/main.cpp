@@ -10,8 +10,42 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/ClusteredLights.h>
+#include <rg/CameraTrack.h>
+#include <rg/CpuProfiler.h>
+#include <rg/FrameCapture.h>
+#include <rg/FrameClock.h>
+#include <rg/FramePacer.h>
+#include <rg/GLExtensions.h>
+#include <rg/GpuMemory.h>
+#include <rg/GpuProfiler.h>
+#include <rg/ProgramCache.h>
+#include <rg/ShaderPermutations.h>
+#include <rg/ShaderWatcher.h>
+#include <rg/SimulationThread.h>
+#include <rg/HeadlessContext.h>
+#include <rg/Json.h>
+#include <rg/JobSystem.h>
+#include <rg/RegressionSuite.h>
+#include <rg/Scene.h>
+#include <rg/StartupReport.h>
+#include <rg/UploadRing.h>
+
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
 
 #include <iostream>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
 #include <random>
 
 
@@ -24,6 +58,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+void applyVsync();
 
 unsigned int loadTexture(char const * path);
 
@@ -39,9 +74,19 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// timing
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+// timing: sampled once per frame, the scene is simulated in fixed steps of 1/60 s
+FrameClock frameClock(1.0 / 60.0);
+// interactive runs simulate on their own thread (--no-simulation-thread keeps it in the render loop); while it
+// runs it owns the camera and the ship, and the render loop copies them from its snapshots every frame
+SimulationThread *simulationThread = NULL;
+
+// pacing: vsync (--vsync, V cycles it), frame cap (--fps-cap) and frames in flight (--max-frames-in-flight);
+// the probe times input events from the callbacks to the presentation of the frame that used them
+FramePacer framePacer;
+LatencyProbe latencyProbe;
+
+// the window's framebuffer, or the offscreen one that stands in for it in headless runs
+unsigned int defaultFramebuffer = 0;
 
 
 struct DirectionLight {
@@ -57,50 +102,379 @@ Camera camera(glm::vec3(0.0f, 0.0f, 70.0f));
 bool ssaoButton=false;
 bool mouseEnabled = false;
 bool cameraMouseMovementUpdateEnabled = true;
-float rotateAngle = 0.0f;
+float rotateAngle = 0.0f; // interpolated roll the ship is drawn with
+float shipTilt = 0.0f;
+// ship roll in the fixed-step simulation, A/D set the direction
+int shipTurn = 0;
+float shipRoll = 0.0f, previousShipRoll = 0.0f;
+
+// camera path recording (--record) and playback (--play), N starts a new segment while recording
+CameraTrack cameraTrack;
+bool recordingTrack = false;
+
+// F saves the next frame as a screenshot; --capture saves every frame
+bool screenshotRequested = false;
+
+// extra rocks in a belt around the planet, for the stress scene (--asteroids N, the "asteroids" regression view)
+unsigned int stressAsteroidCount = 0;
+
+// worker pool for asset loading and the per-frame CPU work (transforms, light culling, sorting); --jobs N
+// sets the number of workers, 0 runs everything on the main thread
+JobSystem *jobSystem = NULL;
+
+// ambient occlusion algorithms that can be swapped in front of the shared blur stage
+enum AOAlgorithm {
+    AO_SSAO = 0,
+    AO_HBAO,
+    AO_GTAO,
+    AO_ALGORITHM_COUNT
+};
+const char *aoAlgorithmNames[AO_ALGORITHM_COUNT] = { "SSAO", "HBAO", "GTAO" };
+AOAlgorithm aoAlgorithm = AO_SSAO;
+// depth taps per pixel, spread over kernel samples / directions / slices depending on the algorithm
+unsigned int aoSampleCount = 64;
+const unsigned int AO_MAX_SAMPLES = 256;
+// SSAO runs as compute shaders when the context supports GL 4.3, K switches back to the fragment path
+bool computeSSAO = true;
+
+// number of dynamic point lights in the deferred path, L steps through these
+const unsigned int lightCountSteps[] = { 10, 100, 1000, 10000 };
+const unsigned int lightCountStepsSize = sizeof(lightCountSteps) / sizeof(lightCountSteps[0]);
+unsigned int sceneLightCount = lightCountSteps[0];
+
+// the forward path lays down depth first so model.fs runs once per covered pixel, P toggles it
+bool depthPrepass = true;
+
+// passes timed by the GPU profiler, G toggles its overlay
+enum RenderPass {
+    PASS_GEOMETRY = 0,
+    PASS_AO,
+    PASS_BLUR,
+    PASS_LIGHTING,
+    PASS_FORWARD_OPAQUE,
+    PASS_SKYBOX,
+    PASS_BLENDING,
+    PASS_COUNT
+};
+const char *renderPassNames[PASS_COUNT] = { "geometry", "ambient occlusion", "blur", "lighting", "forward opaque",
+                                            "skybox", "blending" };
+bool showProfiler = true;
 
 void renderCube();
 void renderQuad();
+void renderSkybox(Shader &skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture, const glm::mat4 &projection);
+// the scene's entities and the ones buildScene moves: the ship rides on a rig that follows the camera, the
+// nine rocks and the stress belt are consecutive entities; the planet never changes after it's created
+Scene scene;
+struct SceneEntities {
+    Scene::Entity planet, cameraRig, ship, rocks, asteroids;
+    unsigned int asteroidCount;
+};
+SceneEntities sceneEntities;
+
+// per-draw data (the DrawData block of draw_data.glsl) is written into a ring of persistently mapped memory,
+// an orphaned buffer on GL 3.3 or with --gl33, and bound at DRAW_DATA_BINDING
+UploadRing *drawUploads = NULL;
+const GLuint DRAW_DATA_BINDING = 0;
+
+void buildScene(std::vector<Scene::Entity> &draws, Model &planetModel, Model &shipModel, Model &rockModel, float time);
+void createSceneEntities(Model &planetModel, Model &shipModel, Model &rockModel);
+void sortFrontToBack(std::vector<Scene::Entity> &draws, const glm::mat4 &view);
+void drawScene(Shader &shader, const std::vector<Scene::Entity> &draws, const glm::mat3 &normalView = glm::mat3(1.0f));
+std::vector<glm::vec3> generateSSAOKernel(unsigned int kernelSize);
+void configureAOShader(Shader &shader, AOAlgorithm algorithm, unsigned int sampleCount, bool compute);
+void setBenchmarkCamera(unsigned int frame, unsigned int frameCount);
+std::vector<PointLight> createSceneLights(unsigned int count);
+void animateSceneLights(std::vector<PointLight> &lights, const std::vector<PointLight> &baseLights, float time);
+void writeCpuTrace(const std::string &path);
+double elapsedSeconds();
+double percentile(std::vector<double> values, double p);
+
+// frame and per-pass times of one benchmark run, in milliseconds
+struct BenchmarkRun {
+    std::string path;
+    std::vector<double> frameTimes;
+    std::vector<std::vector<double>> passTimes;
+};
+void writeBenchmarkReport(std::ostream &out, const std::vector<BenchmarkRun> &runs,
+                          const std::vector<std::pair<std::string, double>> &startup, unsigned int frames,
+                          unsigned int warmup, float timestep, bool headless);
+
+// what the standalone benchmarks need of the renderer main sets up: its passes, as the lambdas main defines
+// them, and the objects they draw with
+struct BenchmarkRenderer {
+    GpuProfiler &gpuProfiler;
+    JobSystem &jobs;
+    Shader &shaderGeometryPass;
+    unsigned int ssaoBlurFBO;
+    Model &planetModel, &shipModel, &rockModel;
+    std::vector<Scene::Entity> &sceneDraws;
+    ClusteredLights &clusteredLights;
+    std::function<Shader &(AOAlgorithm, unsigned int)> aoShader;
+    std::function<void(Shader &, const glm::mat4 &, const glm::mat4 &, float)> renderGeometryPass;
+    std::function<void(const glm::mat4 &, const glm::mat4 &, float, bool, bool, const unsigned int *)>
+            renderForwardOpaque;
+    std::function<void(AOAlgorithm, unsigned int, bool, const glm::mat4 &, GpuProfiler *)> renderAmbientOcclusion;
+    std::function<void()> presentFrame;
+};
+glm::mat4 benchmarkProjection();
+void printTableRow(const std::vector<std::string> &cells, const std::vector<int> &widths);
+std::string formatFixed(double value, int precision);
+void runAOBenchmark(BenchmarkRenderer &renderer);
+void runPrepassBenchmark(BenchmarkRenderer &renderer);
+void runNormalMatrixBenchmark(BenchmarkRenderer &renderer);
+void runJobBenchmark(BenchmarkRenderer &renderer);
+void runSceneBenchmark(BenchmarkRenderer &renderer);
+
+// canonical views of the regression tests: render path, stress rocks and the camera's step on the benchmark orbit
+struct RegressionView {
+    const char *name;
+    bool ssao;
+    unsigned int asteroids;
+    unsigned int orbitStep; // of REGRESSION_ORBIT_STEPS
+};
+const unsigned int REGRESSION_ORBIT_STEPS = 8;
+const RegressionView regressionViews[] = {
+        { "forward", false, 0, 0 },
+        { "ssao", true, 0, 1 },
+        { "asteroids", true, 1000, 2 }
+};
 float lerp(float a, float b, float f)
 {
     return a + f * (b - a);
 }
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char **argv) {
+    elapsedSeconds(); // startup times count from here
+    StartupReport::BeginPhase("context");
+    bool aoBenchmark = false;
+    bool lightBenchmark = false;
+    bool prepassBenchmark = false;
+    bool normalMatrixBenchmark = false;
+    bool jobBenchmark = false;
+    bool sceneBenchmark = false;
+    int jobWorkers = -1; // one per core besides the main thread
+    bool forceGL33 = false;
+    bool headless = false;
+    bool benchmark = false;
+    unsigned int benchmarkFrames = 600;
+    std::string benchmarkOutput;
+    std::string recordPath, playPath;
+    std::string captureDirectory;
+    FrameCapture::Format captureFormat = FrameCapture::PNG;
+    // regression tests: a view name or "all"; --output is the directory the rendered images go to
+    std::string regressionSelection;
+    std::string goldenDirectory = FileSystem::getPath("tests/golden");
+    bool updateGolden = false;
+    bool requireGolden = false;    // a missing golden or baseline fails instead of skipping
+    float imageTolerance = 0.5f;   // percent of pixels
+    float perfThreshold = 0.25f;   // fraction of the baseline
+    // CPU zones of the whole run are written here on exit (needs RG_CPU_PROFILER)
+    std::string tracePath;
+    // the startup breakdown is written here once the first frame is presented
+    std::string startupReportPath;
+    // linked program binaries, empty with --no-shader-cache
+    std::string shaderCacheDirectory = "shader_cache";
+    // rebuild programs when their files in resources/shaders change, in interactive runs
+    bool shaderReload = true;
+    bool simulationOnThread = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--ao-benchmark") == 0)
+            aoBenchmark = true;
+        else if (std::strcmp(argv[i], "--light-benchmark") == 0)
+            lightBenchmark = true;
+        else if (std::strcmp(argv[i], "--prepass-benchmark") == 0)
+            prepassBenchmark = true;
+        else if (std::strcmp(argv[i], "--normal-matrix-benchmark") == 0)
+            normalMatrixBenchmark = true;
+        else if (std::strcmp(argv[i], "--job-benchmark") == 0)
+            jobBenchmark = true;
+        else if (std::strcmp(argv[i], "--scene-benchmark") == 0)
+            sceneBenchmark = true;
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobWorkers = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--gl33") == 0)
+            forceGL33 = true;
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (std::strcmp(argv[i], "--startup-report") == 0 && i + 1 < argc)
+            startupReportPath = argv[++i];
+        else if (std::strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (std::strcmp(argv[i], "--benchmark") == 0)
+            benchmark = true;
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            benchmarkFrames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            benchmarkOutput = argv[++i];
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--play") == 0 && i + 1 < argc)
+            playPath = argv[++i];
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            captureDirectory = argv[++i];
+        else if (std::strcmp(argv[i], "--asteroids") == 0 && i + 1 < argc)
+            stressAsteroidCount = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--regression") == 0 && i + 1 < argc)
+            regressionSelection = argv[++i];
+        else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        else if (std::strcmp(argv[i], "--update-golden") == 0)
+            updateGolden = true;
+        else if (std::strcmp(argv[i], "--require-golden") == 0)
+            requireGolden = true;
+        else if (std::strcmp(argv[i], "--image-tolerance") == 0 && i + 1 < argc)
+            imageTolerance = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--perf-threshold") == 0 && i + 1 < argc)
+            perfThreshold = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+            shaderCacheDirectory = argv[++i];
+        else if (std::strcmp(argv[i], "--no-shader-cache") == 0)
+            shaderCacheDirectory.clear();
+        else if (std::strcmp(argv[i], "--no-shader-reload") == 0)
+            shaderReload = false;
+        else if (std::strcmp(argv[i], "--no-simulation-thread") == 0)
+            simulationOnThread = false;
+        else if (std::strcmp(argv[i], "--vsync") == 0 && i + 1 < argc) {
+            i++;
+            framePacer.SetVsync(std::strcmp(argv[i], "off") == 0 ? FramePacer::VSYNC_OFF
+                              : std::strcmp(argv[i], "adaptive") == 0 ? FramePacer::VSYNC_ADAPTIVE
+                              : FramePacer::VSYNC_ON);
+        }
+        else if (std::strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc)
+            framePacer.SetFrameCap(std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--max-frames-in-flight") == 0 && i + 1 < argc)
+            framePacer.SetMaxFramesInFlight(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc) {
+            i++;
+            captureFormat = std::strcmp(argv[i], "raw") == 0 ? FrameCapture::RAW
+                          : std::strcmp(argv[i], "pfm") == 0 ? FrameCapture::PFM : FrameCapture::PNG;
+        }
+    }
+    std::vector<RegressionView> regressionRuns;
+    for (const RegressionView &view : regressionViews)
+        if (regressionSelection == "all" || regressionSelection == view.name)
+            regressionRuns.push_back(view);
+    if (!regressionSelection.empty() && regressionRuns.empty()) {
+        std::cout << "Unknown regression view: " << regressionSelection << std::endl;
+        return -1;
+    }
+    bool regression = !regressionRuns.empty();
+    bool playback = !playPath.empty() && !regression;
+    if (playback && !cameraTrack.Load(playPath))
+        return -1;
+    recordingTrack = !recordPath.empty() && !playback;
+    // without a window nobody can close the render loop, so a headless run always benchmarks, plays a track
+    // or runs the regression views
+    if (headless && !aoBenchmark && !lightBenchmark && !prepassBenchmark && !normalMatrixBenchmark && !jobBenchmark &&
+        !sceneBenchmark && !playback && !regression)
+        benchmark = true;
+    if (benchmark || playback || regression)
+        lightBenchmark = false;
+    if (playback || regression)
+        benchmark = false;
+    // made on this thread, which is the one that runs the GL jobs
+    JobSystem jobs(jobWorkers < 0 ? JobSystem::DefaultWorkers() : jobWorkers);
+    jobSystem = &jobs;
+
+    GLFWwindow *window = NULL;
+    GLADloadproc loadProc = (GLADloadproc) glfwGetProcAddress;
+#ifdef RG_HEADLESS
+    HeadlessContext headlessContext;
+    if (headless) {
+        // headless: EGL context without a surface, same 4.3 then 3.3 order as the window
+        if (!(!forceGL33 && headlessContext.Create(4, 3)) && !headlessContext.Create(3, 3)) {
+            std::cout << "Failed to create headless OpenGL context" << std::endl;
+            return -1;
+        }
+        loadProc = HeadlessContext::GetProcAddress;
+    }
+#else
+    if (headless) {
+        std::cout << "Headless mode needs EGL, this build was configured without it" << std::endl;
+        return -1;
+    }
+#endif
+    if (!headless) {
+
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // the deferred path copies the G-buffer's depth-stencil into the default framebuffer
+        glfwWindowHint(GLFW_DEPTH_BITS, 24);
+        glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "SPACE", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // glfw window creation: ask for 4.3 for the compute paths and fall back to 3.3
+        // ------------------------------------------------------------------------------
+        window = forceGL33 ? NULL : glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "SPACE", NULL, NULL);
+        if (window == NULL) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "SPACE", NULL, NULL);
+        }
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        applyVsync();
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    if (!gladLoadGLLoader(loadProc)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadGLExtensions(loadProc);
+    // --gl33 keeps whatever context the driver returns but sticks to the 3.3 code paths
+    if (forceGL33) {
+        rg::glCaps.computeShaders = false;
+        rg::glCaps.bufferStorage = false;
+    }
+    std::cout << "OpenGL " << rg::glCaps.major << "." << rg::glCaps.minor
+              << (rg::glCaps.computeShaders ? ", compute SSAO available" : ", fragment SSAO only")
+              << (rg::glCaps.bufferStorage ? ", persistently mapped uploads" : ", orphaned uploads") << std::endl;
+    // grows on its own when a frame needs more
+    UploadRing drawUploadRing(1 << 20);
+    drawUploads = &drawUploadRing;
+    drawUploads->BeginFrame();
+#ifdef RG_HEADLESS
+    if (headless)
+        defaultFramebuffer = headlessContext.CreateFramebuffer(SCR_WIDTH, SCR_HEIGHT);
+#endif
+    StartupReport::BeginPhase("imgui and profilers");
+
+    // imgui: the overlay for the GPU profiler, installed after our callbacks so it chains to them
+    // ------------------------------------------------------------------------------------------
+    if (window) {
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGui::GetIO().IniFilename = NULL;
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
+    else
+        showProfiler = false;
+    GpuProfiler gpuProfiler(std::vector<std::string>(renderPassNames, renderPassNames + PASS_COUNT));
+    FrameCapture frameCapture;
+    const char *captureExtension = captureFormat == FrameCapture::RAW ? ".raw"
+                                 : captureFormat == FrameCapture::PFM ? ".pfm" : ".png";
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     //stbi_set_flip_vertically_on_load(true);
@@ -115,30 +489,86 @@ int main() {
 
     // build and compile shaders
     // -------------------------
+    StartupReport::BeginPhase("shaders");
+    ProgramCache::SetDirectory(shaderCacheDirectory);
+    double shadersStart = elapsedSeconds();
+    // every program is submitted before any result is checked, so a driver with parallel compile works on all
+    // of them at once; none of them may be used before shaderBatch.Finish()
+    ShaderBatch shaderBatch;
     Shader modelShader("resources/shaders/model.vs", "resources/shaders/model.fs");
+    Shader depthPrepassShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
     Shader shaderGeometryPass("resources/shaders/ssao_geometry.vs", "resources/shaders/ssao_geometry.fs");
-    Shader shaderLightingPass("resources/shaders/ssao.vs", "resources/shaders/ssao_lighting.fs");
-    Shader shaderSSAO("resources/shaders/ssao.vs", "resources/shaders/ssao.fs");
+    // the deferred lighting pass reads the blurred AO buffer only in its AMBIENT_OCCLUSION permutation
+    ShaderFeatures lightingFeatures;
+    lightingFeatures.ambientOcclusion = true;
+    Shader shaderLightingPass({ { GL_VERTEX_SHADER, "resources/shaders/ssao.vs" },
+                                { GL_FRAGMENT_SHADER, "resources/shaders/ssao_lighting.fs" } },
+                              lightingFeatures.Defines());
+    // shader hot reload: programs are rebuilt on the context of a hidden window that shares objects with the
+    // main one; measured and replayed runs keep the programs they started with
+    ShaderWatcher shaderWatcher;
+    bool watchShaders = shaderReload && window && !benchmark && !lightBenchmark && !playback && !regression;
+    // the AO passes are compiled per sample count (SAMPLE_COUNT) so their loops have constant bounds; a
+    // permutation is built the first time a count is used, the current one right here
+    const char *aoFragmentShaders[AO_ALGORITHM_COUNT] = { "resources/shaders/ssao.fs",
+                                                          "resources/shaders/ssao_hbao.fs",
+                                                          "resources/shaders/ssao_gtao.fs" };
+    std::vector<ShaderPermutations> aoPermutations;
+    for (const char *fragmentShader : aoFragmentShaders)
+        aoPermutations.emplace_back(std::vector<Shader::Stage>{ { GL_VERTEX_SHADER, "resources/shaders/ssao.vs" },
+                                                                { GL_FRAGMENT_SHADER, fragmentShader } },
+                                    [&shaderWatcher, watchShaders](Shader &shader) {
+                                        shader.use();
+                                        shader.setInt("gPosition", 0);
+                                        shader.setInt("gNormal", 1);
+                                        shader.setInt("texNoise", 2);
+                                        if (watchShaders)
+                                            shaderWatcher.Watch(&shader);
+                                    });
+    auto aoShader = [&aoPermutations](AOAlgorithm algorithm, unsigned int sampleCount) -> Shader & {
+        ShaderFeatures features;
+        features.sampleCount = std::min(sampleCount, AO_MAX_SAMPLES);
+        return aoPermutations[algorithm].Get(features);
+    };
+    for (int algorithm = 0; algorithm < AO_ALGORITHM_COUNT; algorithm++)
+        aoShader((AOAlgorithm) algorithm, aoSampleCount);
+    std::unique_ptr<Shader> shaderSSAOCompute, shaderSSAOBlurCompute;
+    if (rg::glCaps.computeShaders) {
+        shaderSSAOCompute.reset(new Shader("resources/shaders/ssao.cs"));
+        shaderSSAOBlurCompute.reset(new Shader("resources/shaders/ssao_blur.cs"));
+    }
     Shader shaderSSAOBlur("resources/shaders/ssao.vs", "resources/shaders/ssao_blur.fs");
+    shaderBatch.Finish();
+    // a cold start compiles every program, a warm one loads them all from the cache
+    std::cout << "Shaders: " << std::fixed << std::setprecision(1) << (elapsedSeconds() - shadersStart) * 1000.0
+              << " ms, " << ProgramCache::Hits() << " of " << ProgramCache::Hits() + ProgramCache::Misses()
+              << " programs from the binary cache";
+    if (!ProgramCache::Enabled())
+        std::cout << (shaderCacheDirectory.empty() ? " (disabled)" : " (no program binary support)");
+    else if (ProgramCache::Rejected())
+        std::cout << ", " << ProgramCache::Rejected() << " rejected by the driver";
+    if (rg::glCaps.parallelShaderCompile)
+        std::cout << ", compiled in parallel";
+    std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
 
 
     // load models
     // -----------
-    Model planetModel("resources/objects/mercury_planet/scene.gltf");
+    // the models are imported and their textures decoded on the workers, side by side; the buffers and
+    // textures are made here while waiting
+    StartupReport::BeginPhase("models");
+    JobSystem::Counter modelsLoaded;
+    Model planetModel("resources/objects/mercury_planet/scene.gltf", jobs, modelsLoaded);
+    Model shipModel("resources/objects/space_ship1/mc80-liberty-type-star-cruiser/source/MC80 Liberty type Star Cruiser.obj",
+                    jobs, modelsLoaded);
+    Model rockModel("resources/objects/rock/rock.obj", jobs, modelsLoaded);
+    jobs.Wait(modelsLoaded);
     planetModel.SetShaderTextureNamePrefix("material.");
-
-    Model shipModel("resources/objects/space_ship1/mc80-liberty-type-star-cruiser/source/MC80 Liberty type Star Cruiser.obj");
     shipModel.SetShaderTextureNamePrefix("material.");
-
-    Model rockModel("resources/objects/rock/rock.obj");
     rockModel.SetShaderTextureNamePrefix("material.");
-
-    glm::vec3 planetPosition = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 shipPosition;
-
-    glm::vec3 rockScale = glm::vec3(0.7f);
+    StartupReport::BeginPhase("textures");
 
     float skyboxVertices[] = {
             // positions
@@ -202,6 +632,7 @@ int main() {
     glBindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    GpuMemory::TrackBuffer(skyboxVBO, GpuMemory::OTHER, "skybox vertices", sizeof(skyboxVertices));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
@@ -212,6 +643,7 @@ int main() {
     glBindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
+    GpuMemory::TrackBuffer(transparentVBO, GpuMemory::OTHER, "transparent quad vertices", sizeof(transparentVertices));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
@@ -242,6 +674,7 @@ int main() {
                     FileSystem::getPath("resources/textures/space/back.jpg")
             };
     unsigned int cubemapTexture = loadCubemap(faces);
+    StartupReport::BeginPhase("render targets");
 
     // shader configuration
     // --------------------
@@ -260,6 +693,7 @@ int main() {
     glGenTextures(1, &gPosition);
     glBindTexture(GL_TEXTURE_2D, gPosition);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    GpuMemory::TrackTexture(gPosition, GpuMemory::RENDER_TARGET, "G-buffer position", SCR_WIDTH, SCR_HEIGHT, GL_RGBA16F);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -269,6 +703,7 @@ int main() {
     glGenTextures(1, &gNormal);
     glBindTexture(GL_TEXTURE_2D, gNormal);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    GpuMemory::TrackTexture(gNormal, GpuMemory::RENDER_TARGET, "G-buffer normal", SCR_WIDTH, SCR_HEIGHT, GL_RGBA16F);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
@@ -276,22 +711,26 @@ int main() {
     glGenTextures(1, &gAlbedo);
     glBindTexture(GL_TEXTURE_2D, gAlbedo);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    GpuMemory::TrackTexture(gAlbedo, GpuMemory::RENDER_TARGET, "G-buffer albedo", SCR_WIDTH, SCR_HEIGHT, GL_RGBA8);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
     unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
     glDrawBuffers(3, attachments);
-    // create and attach depth buffer (renderbuffer)
+    // create and attach depth-stencil buffer (renderbuffer); the geometry pass marks covered pixels
+    // with stencil 1 so the passes after it can skip empty space
     unsigned int rboDepth;
     glGenRenderbuffers(1, &rboDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
+    GpuMemory::TrackRenderbuffer(rboDepth, GpuMemory::RENDER_TARGET, "G-buffer depth-stencil", SCR_WIDTH, SCR_HEIGHT,
+                                 GL_DEPTH24_STENCIL8);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
 
     // also create framebuffer to hold SSAO processing stage
     // -----------------------------------------------------
@@ -302,38 +741,30 @@ int main() {
     // SSAO color buffer
     glGenTextures(1, &ssaoColorBuffer);
     glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+    GpuMemory::TrackTexture(ssaoColorBuffer, GpuMemory::RENDER_TARGET, "SSAO", SCR_WIDTH, SCR_HEIGHT, GL_R16F);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBuffer, 0);
+    // share the G-buffer's stencil mask
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "SSAO Framebuffer not complete!" << std::endl;
     // and blur stage
     glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
     glGenTextures(1, &ssaoColorBufferBlur);
     glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+    GpuMemory::TrackTexture(ssaoColorBufferBlur, GpuMemory::RENDER_TARGET, "SSAO blur", SCR_WIDTH, SCR_HEIGHT, GL_R16F);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoColorBufferBlur, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "SSAO Blur Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
     std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
     std::default_random_engine generator;
-    std::vector<glm::vec3> ssaoKernel;
-    for (unsigned int i = 0; i < 64; ++i)
-    {
-        glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
-        sample = glm::normalize(sample);
-        sample *= randomFloats(generator);
-        float scale = float(i) / 64.0;
-
-        // scale samples s.t. they're more aligned to center of kernel
-        scale = lerp(0.1f, 1.0f, scale * scale);
-        sample *= scale;
-        ssaoKernel.push_back(sample);
-    }
     // generate noise texture
     // ----------------------
     std::vector<glm::vec3> ssaoNoise;
@@ -345,14 +776,16 @@ int main() {
     unsigned int noiseTexture; glGenTextures(1, &noiseTexture);
     glBindTexture(GL_TEXTURE_2D, noiseTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
+    GpuMemory::TrackTexture(noiseTexture, GpuMemory::OTHER, "SSAO noise", 4, 4, GL_RGBA32F);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     // lighting info
     // -------------
-    glm::vec3 lightPos = glm::vec3(2.0, 4.0, -2.0);
-    glm::vec3 lightColor = glm::vec3(0.86, 0.3f, 0.2f);
+    std::vector<PointLight> baseLights = createSceneLights(sceneLightCount);
+    std::vector<PointLight> sceneLights = baseLights;
+    ClusteredLights clusteredLights(SCR_WIDTH, SCR_HEIGHT);
 
     // shader configuration
     // --------------------
@@ -361,376 +794,488 @@ int main() {
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedo", 2);
     shaderLightingPass.setInt("ssao", 3);
-    shaderSSAO.use();
-    shaderSSAO.setInt("gPosition", 0);
-    shaderSSAO.setInt("gNormal", 1);
-    shaderSSAO.setInt("texNoise", 2);
+    // attenuation parameters
+    const float linear = 0.09;
+    const float quadratic = 0.032;
+    shaderLightingPass.setFloat("lightLinear", linear);
+    shaderLightingPass.setFloat("lightQuadratic", quadratic);
+    if (shaderSSAOCompute) {
+        shaderSSAOCompute->use();
+        shaderSSAOCompute->setInt("gPosition", 0);
+        shaderSSAOCompute->setInt("gNormal", 1);
+        shaderSSAOCompute->setInt("texNoise", 2);
+    }
     shaderSSAOBlur.use();
     shaderSSAOBlur.setInt("ssaoInput", 0);
+    if (shaderSSAOBlurCompute) {
+        shaderSSAOBlurCompute->use();
+        shaderSSAOBlurCompute->setInt("ssaoInput", 0);
+    }
+
+    // geometry pass: render scene's geometry/color data into gbuffer and mark covered pixels in the stencil
+    // ------------------------------------------------------------------------------------------------------
+    std::vector<Scene::Entity> sceneDraws;
+    auto renderGeometryPass = [&](Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, float time) {
+        RG_PROFILE_ZONE("geometry pass");
+        buildScene(sceneDraws, planetModel, shipModel, rockModel, time);
+        sortFrontToBack(sceneDraws, view);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glStencilMask(0xFF);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        // the G-buffer holds view-space normals; the view is a rotation and translation, so its rotation
+        // takes the world-space normal matrices there
+        drawScene(shader, sceneDraws, glm::mat3(view));
+        glDisable(GL_STENCIL_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+    };
+
+    // forward opaque pass: with the pre-pass the depth buffer already holds the nearest surface when
+    // model.fs runs, so hidden fragments fail the depth test instead of being shaded and overwritten.
+    // The optional queries time the whole pass and count the shading pass' fragment invocations.
+    // ------------------------------------------------------------------------------------------------
+    auto renderForwardOpaque = [&](const glm::mat4 &projection, const glm::mat4 &view, float time, bool prepass,
+                                   bool sorted, const unsigned int *queries) {
+        RG_PROFILE_ZONE("forward opaque");
+        GLenum fragmentQuery = rg::glCaps.pipelineStatistics ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB : GL_SAMPLES_PASSED;
+        buildScene(sceneDraws, planetModel, shipModel, rockModel, time);
+        if (sorted)
+            sortFrontToBack(sceneDraws, view);
+        if (queries)
+            glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+        if (prepass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depthPrepassShader.use();
+            depthPrepassShader.setMat4("projection", projection);
+            depthPrepassShader.setMat4("view", view);
+            drawScene(depthPrepassShader, sceneDraws);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
+
+        {
+            RG_PROFILE_ZONE("uniforms");
+            // don't forget to enable shader before setting uniforms
+            modelShader.use();
+            modelShader.setVec3("viewPosition", camera.Position);
 
+            // directional light
+            modelShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
+            modelShader.setVec3("dirLight.ambient", 0.08f, 0.08f, 0.08f);
+            modelShader.setVec3("dirLight.diffuse", 1.4f, 1.4f, 1.4f);
+            modelShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+
+            modelShader.setMat4("projection", projection);
+            modelShader.setMat4("view", view);
+        }
+        if (queries)
+            glBeginQuery(fragmentQuery, queries[1]);
+        drawScene(modelShader, sceneDraws);
+        if (queries) {
+            glEndQuery(fragmentQuery);
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+        if (prepass) {
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+    };
+
+    // AO stage: occlusion from the G-buffer into ssaoColorBuffer, then the 4x4 blur into ssaoColorBufferBlur.
+    // Only SSAO has a compute path, HBAO and GTAO always run as fragment passes. The fragment passes are
+    // stencil tested against the geometry mask; empty pixels keep the cleared value of 1 (unoccluded).
+    // If a profiler is given, the AO and the blur pass are timed as PASS_AO and PASS_BLUR.
+    // ---------------------------------------------------------------------------------------------------------
+    const unsigned int computeGroupsX = (SCR_WIDTH + 15) / 16;
+    const unsigned int computeGroupsY = (SCR_HEIGHT + 15) / 16;
+    auto renderAmbientOcclusion = [&](AOAlgorithm algorithm, unsigned int sampleCount, bool useCompute,
+                                      const glm::mat4 &projection, GpuProfiler *profiler) {
+        RG_PROFILE_ZONE("ambient occlusion");
+        bool compute = useCompute && algorithm == AO_SSAO && shaderSSAOCompute;
+        Shader &shaderAO = compute ? *shaderSSAOCompute : aoShader(algorithm, sampleCount);
+        shaderAO.use();
+        configureAOShader(shaderAO, algorithm, sampleCount, compute);
+        shaderAO.setMat4("projection", projection);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, noiseTexture);
+        if (!compute) {
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_EQUAL, 1, 0xFF);
+            glStencilMask(0x00);
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        }
+        if (profiler)
+            profiler->Begin(PASS_AO);
+        if (compute) {
+            glBindImageTexture(0, ssaoColorBuffer, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+            glDispatchCompute(computeGroupsX, computeGroupsY, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        else {
+            glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
+            glClear(GL_COLOR_BUFFER_BIT);
+            renderQuad();
+        }
+        if (profiler) {
+            profiler->End(PASS_AO);
+            profiler->Begin(PASS_BLUR);
+        }
+
+        // blur SSAO texture to remove noise
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
+        if (compute) {
+            shaderSSAOBlurCompute->use();
+            glBindImageTexture(0, ssaoColorBufferBlur, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+            glDispatchCompute(computeGroupsX, computeGroupsY, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+        }
+        else {
+            glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
+            glClear(GL_COLOR_BUFFER_BIT);
+            shaderSSAOBlur.use();
+            renderQuad();
+        }
+        if (profiler)
+            profiler->End(PASS_BLUR);
+        if (!compute) {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glStencilMask(0xFF);
+            glDisable(GL_STENCIL_TEST);
+            glEnable(GL_DEPTH_TEST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+    };
+
+
+    // ends a frame: swap and poll with a window, headless frames stay in the offscreen framebuffer
+    auto presentFrame = [&]() {
+        drawUploads->EndFrame();
+        if (window) {
+            RG_PROFILE_ZONE("swap buffers");
+            glfwSwapBuffers(window);
+        }
+        framePacer.FramePresented();
+        latencyProbe.FramePresented();
+        if (window)
+            glfwPollEvents();
+        drawUploads->BeginFrame();
+    };
+
+    // standalone benchmarks: each measures one part of the renderer set up above and exits
+    // -------------------------------------------------------------------------------------
+    if (aoBenchmark || prepassBenchmark || normalMatrixBenchmark || jobBenchmark || sceneBenchmark) {
+        BenchmarkRenderer renderer = { gpuProfiler, jobs, shaderGeometryPass, ssaoBlurFBO, planetModel, shipModel,
+                                       rockModel, sceneDraws, clusteredLights, aoShader, renderGeometryPass,
+                                       renderForwardOpaque, renderAmbientOcclusion, presentFrame };
+        // time the GPU work, not the wait for vsync
+        if (window)
+            glfwSwapInterval(0);
+        if (aoBenchmark)
+            runAOBenchmark(renderer);
+        else if (prepassBenchmark)
+            runPrepassBenchmark(renderer);
+        else if (normalMatrixBenchmark)
+            runNormalMatrixBenchmark(renderer);
+        else if (jobBenchmark)
+            runJobBenchmark(renderer);
+        else
+            runSceneBenchmark(renderer);
+        glfwTerminate();
+        return 0;
+    }
+
+    // light benchmark: fly the benchmark orbit through the deferred path with a growing number of lights
+    // ---------------------------------------------------------------------------------------------------
+    const unsigned int lightBenchmarkFrames = 120;
+    const unsigned int lightBenchmarkWarmup = 10;
+    unsigned int lightBenchmarkRun = 0;
+    unsigned int lightBenchmarkFrame = 0;
+    double lightBenchmarkFrameTime = 0.0, lightBenchmarkCullTime = 0.0, lightBenchmarkLightingTime = 0.0;
+    if (lightBenchmark) {
+        showProfiler = false;
+        frameClock.SetTimeSource(FrameClock::FixedTime(1.0 / 60.0));
+        // measure how long frames take, not how long we wait for vsync
+        if (window)
+            glfwSwapInterval(0);
+        sceneLightCount = lightCountSteps[0];
+        std::cout << "Light benchmark: " << SCR_WIDTH << "x" << SCR_HEIGHT << ", " << lightBenchmarkFrames
+                  << " frames per run" << std::endl;
+        std::cout << std::left << std::setw(8) << "lights" << std::setw(12) << "frame ms" << std::setw(12) << "cull ms"
+                  << std::setw(14) << "lighting ms" << std::setw(16) << "lights/cluster" << "dropped pairs" << std::endl;
+    }
+
+    // benchmark: the real scene over the benchmark orbit with a fixed timestep, first the forward path and
+    // then the deferred one; frame times, per-pass GPU times and startup times end up in a JSON report
+    // ---------------------------------------------------------------------------------------------------
+    const float benchmarkTimestep = 1.0f / 60.0f;
+    const unsigned int benchmarkWarmup = 30;
+    const char *benchmarkPaths[] = { "forward", "deferred" };
+    std::vector<BenchmarkRun> benchmarkRuns;
+    unsigned int benchmarkRun = 0;
+    unsigned int benchmarkFrame = 0;
+    if (benchmark) {
+        showProfiler = false;
+        if (window)
+            glfwSwapInterval(0);
+        frameClock.SetTimeSource(FrameClock::FixedTime(benchmarkTimestep));
+        for (const char *path : benchmarkPaths)
+            benchmarkRuns.push_back({ path, {}, std::vector<std::vector<double>>(PASS_COUNT) });
+    }
+    // playback: the track drives the camera, the input and the frame clock, so every run renders the same
+    // frames; frame times are reported per segment of the track
+    // -----------------------------------------------------------------------------------------------------
+    unsigned int playbackFrame = 0;
+    std::vector<std::vector<double>> playbackFrameTimes(cameraTrack.Segments().size());
+    if (playback) {
+        showProfiler = false;
+        if (window)
+            glfwSwapInterval(0);
+        frameClock.SetTimeSource([&playbackFrame]() { return cameraTrack.TimeAt(playbackFrame); });
+    }
+    // regression: every selected view renders regressionFrames frames from a fixed camera with a fixed timestep.
+    // The last frame and, in the deferred views, the G-buffer and the blurred SSAO are captured and compared
+    // with the goldens; frame and pass times between the warmup and the captured frame with the baselines.
+    // G-buffer positions and normals are floating point with negative components, they're captured as PFM and
+    // compared per channel; the final image, albedo and SSAO as PNG and compared perceptually.
+    // -----------------------------------------------------------------------------------------------------------
+    const unsigned int regressionFrames = 40;
+    const unsigned int regressionWarmup = 10;
+    struct RegressionIntermediate {
+        const char *suffix;
+        unsigned int framebuffer;
+        GLenum attachment;
+        FrameCapture::Format format; // PNG or PFM
+    };
+    const RegressionIntermediate regressionIntermediates[] = {
+            { "_gposition", gBuffer, GL_COLOR_ATTACHMENT0, FrameCapture::PFM },
+            { "_gnormal", gBuffer, GL_COLOR_ATTACHMENT1, FrameCapture::PFM },
+            { "_galbedo", gBuffer, GL_COLOR_ATTACHMENT2, FrameCapture::PNG },
+            { "_ssao", ssaoBlurFBO, GL_COLOR_ATTACHMENT0, FrameCapture::PNG }
+    };
+    unsigned int regressionRun = 0;
+    unsigned int regressionFrame = 0;
+    // the frame time first, then one entry per pass
+    std::vector<std::vector<double>> regressionTimes(PASS_COUNT + 1);
+    std::unique_ptr<RegressionSuite> regressionSuite;
+    int exitCode = 0;
+    if (regression) {
+        showProfiler = false;
+        if (window)
+            glfwSwapInterval(0);
+        frameClock.SetTimeSource(FrameClock::FixedTime(benchmarkTimestep));
+        // every captured frame has to reach the disk
+        frameCapture.SetDropWhenFull(false);
+        regressionSuite.reset(new RegressionSuite(goldenDirectory, benchmarkOutput.empty() ? "regression"
+                                                                                          : benchmarkOutput,
+                                                  updateGolden, imageTolerance, perfThreshold, requireGolden));
+    }
+
+    // the AO permutations register themselves when they're built
+    GLFWwindow *shaderReloadWindow = NULL;
+    if (watchShaders) {
+        for (Shader *shader : { &modelShader, &depthPrepassShader, &skyboxShader, &blendingShader,
+                                &shaderGeometryPass, &shaderLightingPass, &shaderSSAOBlur })
+            shaderWatcher.Watch(shader);
+        if (shaderSSAOCompute) {
+            shaderWatcher.Watch(shaderSSAOCompute.get());
+            shaderWatcher.Watch(shaderSSAOBlurCompute.get());
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        shaderReloadWindow = glfwCreateWindow(1, 1, "shader reload", NULL, window);
+    }
+    StartupReport::BeginPhase("first frame");
+
+    // benchmarks, playback, recording and the regression views step the simulation in lockstep with the frames,
+    // which keeps them reproducible; everything else simulates on its own thread
+    SimulationThread simulation(frameClock.FixedStep());
+    if (simulationOnThread && window && !benchmark && !lightBenchmark && !playback && !regression && !recordingTrack) {
+        SceneState initial;
+        initial.camera = camera;
+        initial.shipRoll = shipRoll;
+        simulation.Start(initial);
+        simulationThread = &simulation;
+    }
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
+    while (!window || !glfwWindowShouldClose(window)) {
+        RG_PROFILE_ZONE("frame");
+        shaderWatcher.Poll();
+        // frame cap: poll again after waiting so the frame starts with fresh input
+        if (framePacer.WaitForFrameStart() && window)
+            glfwPollEvents();
+        latencyProbe.BeginFrame();
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        frameClock.Tick();
+        // wall time, only for measuring the frame
+        double frameStart = elapsedSeconds();
 
         // input
         // -----
-        processInput(window);
+        if (window && !playback)
+            processInput(window);
+        if (playback) {
+            const CameraTrackFrame &frame = cameraTrack.Frame(playbackFrame);
+            camera.Position = frame.position;
+            camera.Yaw = frame.yaw;
+            camera.Pitch = frame.pitch;
+            camera.Zoom = frame.zoom;
+            camera.ProcessMouseMovement(0.0f, 0.0f);
+            shipTurn = frame.shipTurn;
+            shipTilt = frame.shipTilt;
+            ssaoButton = frame.ssao;
+        }
+        if (recordingTrack) {
+            cameraTrack.Record({ frameClock.DeltaTime(), camera.Position, camera.Yaw, camera.Pitch, camera.Zoom,
+                                 shipTurn, shipTilt, ssaoButton });
+        }
 
-        if(mouseEnabled) {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        // fixed-step simulation, rendered interpolated between the last two steps; on the simulation thread
+        // the steps happen there and this frame draws its newest snapshot
+        // -----------------------------------------------------------------------------------------------------
+        float sceneTime;
+        if (simulationThread) {
+            SceneState state = simulationThread->Current();
+            camera = state.camera;
+            rotateAngle = state.shipRoll;
+            shipTilt = state.shipTilt;
+            sceneTime = (float) state.time;
         }
         else {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            while (frameClock.Step()) {
+                previousShipRoll = shipRoll;
+                shipRoll += shipTurn * SceneState::SHIP_ROLL_SPEED * frameClock.FixedStep();
+            }
+            rotateAngle = lerp(previousShipRoll, shipRoll, frameClock.Alpha());
+            sceneTime = frameClock.InterpolatedTime();
+        }
+
+        if (lightBenchmark) {
+            setBenchmarkCamera(lightBenchmarkFrame, lightBenchmarkFrames);
+            ssaoButton = true;
+        }
+        if (benchmark) {
+            setBenchmarkCamera(benchmarkFrame, benchmarkFrames);
+            ssaoButton = std::strcmp(benchmarkPaths[benchmarkRun], "deferred") == 0;
+        }
+        if (regression) {
+            const RegressionView &view = regressionRuns[regressionRun];
+            setBenchmarkCamera(view.orbitStep, REGRESSION_ORBIT_STEPS);
+            ssaoButton = view.ssao;
+            stressAsteroidCount = view.asteroids;
+        }
+
+        if (window) {
+            glfwSetInputMode(window, GLFW_CURSOR, mouseEnabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
         }
 
 
         // render
         // ------
+        gpuProfiler.BeginFrame();
         glClearColor(0.0, 0.0, 0.0, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         if(ssaoButton==true){
             // 1. geometry pass: render scene's geometry/color data into gbuffer
             // -----------------------------------------------------------------
-            glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT,
                                                     0.1f, 100.0f);
             glm::mat4 view = camera.GetViewMatrix();
-            glm::mat4 model = glm::mat4(1.0f);
-            shaderGeometryPass.use();
-            shaderGeometryPass.setMat4("projection", projection);
-            shaderGeometryPass.setMat4("view", view);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, planetPosition);
-            model = glm::scale(model, glm::vec3(4.0f));
-            shaderGeometryPass.setMat4("model", model);
-
-            // render the loaded model
-            planetModel.Draw(shaderGeometryPass);
-            shaderGeometryPass.setFloat("material.shininess", 2.0f);
-            glm::mat4 model1 = glm::mat4(1.0f);
-
-            model1 = glm::translate(model1, camera.Position +
-                                            glm::vec3(camera.Front.x, camera.Front.y - 0.4f, camera.Front.z - 0.8f));
-            model1 = glm::scale(model1, glm::vec3(0.0001f));
-            model1 = glm::rotate(model1, (float) glm::radians(rotateAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            model1 = glm::rotate(model1, (float) glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model1 = glm::rotate(model1, glm::radians(-camera.Yaw + 90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-                rotateAngle -= 1.0f;
-            }
-            if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-                rotateAngle += 1.0f;
-            }
-            if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-                model1 = glm::rotate(model1, (float) glm::radians(3.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            }
-            if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-                model1 = glm::rotate(model1, (float) glm::radians(-3.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            }
-            shaderGeometryPass.setMat4("model", model1);
-
-            // render the loaded model
-            shipModel.Draw(shaderGeometryPass);
-
-            glm::mat4 model2 = glm::mat4(1.0f);
-            glm::vec3 rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()),
-                                           10.0f * glm::sin(glfwGetTime()) * glm::cos(glfwGetTime()),
-                                           20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()),
-                                 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()),
-                                 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()),
-                                 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()),
-                                 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f, 20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()), 20.0f);
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()), 20.0f);
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f, 20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            shaderGeometryPass.setMat4("model", model2);
-            rockModel.Draw(shaderGeometryPass);
-
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-            // 2. generate SSAO texture
-            // ------------------------
-            glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-            glClear(GL_COLOR_BUFFER_BIT);
-            shaderSSAO.use();
-            // Send kernel + rotation
-            for (unsigned int i = 0; i < 64; ++i)
-                shaderSSAO.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
-            shaderSSAO.setMat4("projection", projection);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, gPosition);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, gNormal);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, noiseTexture);
-            renderQuad();
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+            gpuProfiler.Begin(PASS_GEOMETRY);
+            renderGeometryPass(shaderGeometryPass, projection, view, sceneTime);
+            gpuProfiler.End(PASS_GEOMETRY);
 
-            // 3. blur SSAO texture to remove noise
-            // ------------------------------------
-            glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-            glClear(GL_COLOR_BUFFER_BIT);
-            shaderSSAOBlur.use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-            renderQuad();
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            // 2. + 3. generate AO texture with the selected algorithm and blur it to remove noise
+            // -----------------------------------------------------------------------------------
+            renderAmbientOcclusion(aoAlgorithm, aoSampleCount, computeSSAO, projection, &gpuProfiler);
 
 
-            // 4. lighting pass: traditional deferred Blinn-Phong lighting with added screen-space ambient occlusion
+            // 4. lighting pass: traditional deferred Blinn-Phong lighting with added screen-space ambient occlusion,
+            // only where the geometry pass left its stencil mark
             // -----------------------------------------------------------------------------------------------------
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+            glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT,
+                              GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+            glEnable(GL_STENCIL_TEST);
+            glStencilMask(0x00);
+            glStencilFunc(GL_EQUAL, 1, 0xFF);
+            glDisable(GL_DEPTH_TEST);
             shaderLightingPass.use();
-            // send light relevant uniforms
-            glm::vec3 lightPosView = glm::vec3(camera.GetViewMatrix() * glm::vec4(lightPos, 1.0));
-            shaderLightingPass.setVec3("light.Position", lightPosView);
-            shaderLightingPass.setVec3("light.Color", lightColor);
-            // Update attenuation parameters
-            const float linear = 0.09;
-            const float quadratic = 0.032;
-            shaderLightingPass.setFloat("light.Linear", linear);
-            shaderLightingPass.setFloat("light.Quadratic", quadratic);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, gPosition);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, gNormal);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, gAlbedo);
-            glActiveTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
-            glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+            // move the lights and bin them into the clusters of this view
+            if (baseLights.size() != sceneLightCount) {
+                baseLights = createSceneLights(sceneLightCount);
+                sceneLights = baseLights;
+            }
+            double cullStart = elapsedSeconds();
+            animateSceneLights(sceneLights, baseLights, sceneTime);
+            clusteredLights.Update(sceneLights, view, projection, 0.1f, 100.0f, jobSystem);
+            if (lightBenchmark && lightBenchmarkFrame >= lightBenchmarkWarmup)
+                lightBenchmarkCullTime += elapsedSeconds() - cullStart;
+            {
+                RG_PROFILE_ZONE("uniforms");
+                clusteredLights.Bind(shaderLightingPass, 4);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, gPosition);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, gNormal);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, gAlbedo);
+                glActiveTexture(GL_TEXTURE3); // add extra SSAO texture to lighting pass
+                glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+            }
+            gpuProfiler.Begin(PASS_LIGHTING);
             renderQuad();
+            gpuProfiler.End(PASS_LIGHTING);
+            glEnable(GL_DEPTH_TEST);
+
+            // 5. the skybox fills the pixels without geometry
+            // ------------------------------------------------
+            glStencilFunc(GL_EQUAL, 0, 0xFF);
+            gpuProfiler.Begin(PASS_SKYBOX);
+            renderSkybox(skyboxShader, skyboxVAO, cubemapTexture, projection);
+            gpuProfiler.End(PASS_SKYBOX);
+            glStencilMask(0xFF);
+            glDisable(GL_STENCIL_TEST);
         }
         else {
-
-            // don't forget to enable shader before setting uniforms
-            modelShader.use();
-            modelShader.setVec3("viewPos", camera.Position);
-
-
-            // directional light
-            modelShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-            modelShader.setVec3("dirLight.ambient", 0.08f, 0.08f, 0.08f);
-            modelShader.setVec3("dirLight.diffuse", 1.4f, 1.4f, 1.4f);
-            modelShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-
             glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
                                                     (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
             glm::mat4 view = camera.GetViewMatrix();
-            modelShader.setMat4("projection", projection);
-            modelShader.setMat4("view", view);
-
-            modelShader.setFloat("material.shininess", 128.0f);
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, planetPosition);
-            model = glm::scale(model, glm::vec3(4.0f));
-            modelShader.setMat4("model", model);
-
-            // render the loaded model
-            planetModel.Draw(modelShader);
-            modelShader.setFloat("material.shininess", 2.0f);
-            glm::mat4 model1 = glm::mat4(1.0f);
-
-            model1 = glm::translate(model1, camera.Position +
-                                            glm::vec3(camera.Front.x, camera.Front.y - 0.4f, camera.Front.z - 0.8f));
-            model1 = glm::scale(model1, glm::vec3(0.0001f));
-            model1 = glm::rotate(model1, (float) glm::radians(rotateAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            model1 = glm::rotate(model1, (float) glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model1 = glm::rotate(model1, glm::radians(-camera.Yaw + 90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-                rotateAngle -= 1.0f;
-            }
-            if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-                rotateAngle += 1.0f;
-            }
-            if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-                model1 = glm::rotate(model1, (float) glm::radians(3.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            }
-            if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-                model1 = glm::rotate(model1, (float) glm::radians(-3.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            }
-            modelShader.setMat4("model", model1);
-
-            // render the loaded model
-            shipModel.Draw(modelShader);
-
-            glm::mat4 model2 = glm::mat4(1.0f);
-            glm::vec3 rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()),
-                                           10.0f * glm::sin(glfwGetTime()) * glm::cos(glfwGetTime()),
-                                           20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()),
-                                 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()),
-                                 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()),
-                                 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()),
-                                 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f, 20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()), 20.0f);
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 1.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f * glm::sin(glfwGetTime()), 20.0f * glm::cos(glfwGetTime()), 20.0f);
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(1.0f, 0.0f, 0.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
-            model2 = glm::mat4(1.0f);
-            rotation = glm::vec3(20.0f, 20.0f * glm::cos(glfwGetTime()), 20.0f * glm::sin(glfwGetTime()));
-            model2 = glm::translate(model2, rotation);
-            model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 0.0f, 1.0f));
-            model2 = glm::scale(model2, rockScale);
-            modelShader.setMat4("model", model2);
-            rockModel.Draw(modelShader);
-
+            gpuProfiler.Begin(PASS_FORWARD_OPAQUE);
+            renderForwardOpaque(projection, view, sceneTime, depthPrepass, true, NULL);
+            gpuProfiler.End(PASS_FORWARD_OPAQUE);
 
             // draw skybox as last
-            glDepthFunc(
-                    GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-            skyboxShader.use();
-            view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-            skyboxShader.setMat4("view", view);
-            skyboxShader.setMat4("projection", projection);
-            // skybox cube
-            glBindVertexArray(skyboxVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glDepthFunc(GL_LESS); // set depth function back to default
+            gpuProfiler.Begin(PASS_SKYBOX);
+            renderSkybox(skyboxShader, skyboxVAO, cubemapTexture, projection);
+            gpuProfiler.End(PASS_SKYBOX);
 
             // draw objects
+            gpuProfiler.Begin(PASS_BLENDING);
             blendingShader.use();
             projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f,
                                           100.0f);
             view = camera.GetViewMatrix();
-            model = glm::mat4(1.0f);
+            glm::mat4 model = glm::mat4(1.0f);
             blendingShader.setMat4("projection", projection);
             blendingShader.setMat4("view", view);
 
@@ -743,45 +1288,262 @@ int main() {
                 blendingShader.setMat4("model", model);
                 glDrawArrays(GL_TRIANGLES, 0, 6);
             }
+            gpuProfiler.End(PASS_BLENDING);
+        }
 
+        // captured before the overlay is drawn; the readback finishes a few frames later
+        {
+            RG_PROFILE_ZONE("frame capture");
+            if (!captureDirectory.empty()) {
+                char name[32];
+                snprintf(name, sizeof(name), "/frame_%05lu", frameClock.Frame());
+                frameCapture.Capture(defaultFramebuffer, SCR_WIDTH, SCR_HEIGHT,
+                                     captureDirectory + name + captureExtension, captureFormat);
+            }
+            if (screenshotRequested) {
+                std::string path = "screenshot_" + std::to_string(frameClock.Frame()) + captureExtension;
+                if (frameCapture.Capture(defaultFramebuffer, SCR_WIDTH, SCR_HEIGHT, path, captureFormat))
+                    std::cout << "Screenshot: " << path << std::endl;
+                screenshotRequested = false;
+            }
+            if (regression && regressionFrame + 1 == regressionFrames) {
+                const RegressionView &view = regressionRuns[regressionRun];
+                frameCapture.Capture(defaultFramebuffer, SCR_WIDTH, SCR_HEIGHT, regressionSuite->OutputPath(view.name));
+                if (view.ssao) {
+                    for (const RegressionIntermediate &intermediate : regressionIntermediates) {
+                        std::string name = std::string(view.name) + intermediate.suffix;
+                        frameCapture.Capture(intermediate.framebuffer, SCR_WIDTH, SCR_HEIGHT,
+                                             intermediate.format == FrameCapture::PFM
+                                                     ? regressionSuite->FloatOutputPath(name)
+                                                     : regressionSuite->OutputPath(name),
+                                             intermediate.format, intermediate.attachment);
+                    }
+                }
+            }
+            frameCapture.Poll();
         }
 
+        if (showProfiler) {
+            RG_PROFILE_ZONE("imgui");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            gpuProfiler.DrawImGui();
+            GpuMemory::DrawImGui();
+            framePacer.DrawImGui(latencyProbe);
+            drawUploads->DrawImGui();
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        gpuProfiler.EndFrame();
+
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        presentFrame();
+        if (!StartupReport::Finished()) {
+            StartupReport::Finish();
+            if (!startupReportPath.empty() && StartupReport::Write(startupReportPath))
+                std::cout << "Startup report written to " << startupReportPath << std::endl;
+            // started after the report is closed, reloads don't count as startup
+            if (shaderReloadWindow)
+                shaderWatcher.Start("resources/shaders", [shaderReloadWindow](bool current) {
+                    glfwMakeContextCurrent(current ? shaderReloadWindow : NULL);
+                });
+        }
+
+        if (lightBenchmark) {
+            // wait for the GPU so the frame time covers the whole frame
+            glFinish();
+            gpuProfiler.Flush();
+            if (lightBenchmarkFrame >= lightBenchmarkWarmup) {
+                lightBenchmarkLightingTime += gpuProfiler.Stats(PASS_LIGHTING).last;
+                lightBenchmarkFrameTime += elapsedSeconds() - frameStart;
+            }
+            if (++lightBenchmarkFrame == lightBenchmarkFrames) {
+                unsigned int measured = lightBenchmarkFrames - lightBenchmarkWarmup;
+                std::cout << std::left << std::setw(8) << sceneLightCount << std::fixed << std::setprecision(3)
+                          << std::setw(12) << lightBenchmarkFrameTime * 1000.0 / measured
+                          << std::setw(12) << lightBenchmarkCullTime * 1000.0 / measured
+                          << std::setw(14) << lightBenchmarkLightingTime / measured
+                          << std::setprecision(2) << std::setw(16)
+                          << (double) clusteredLights.IndexCount() / ClusteredLights::CLUSTER_COUNT
+                          << clusteredLights.Dropped() << std::endl;
+                lightBenchmarkFrame = 0;
+                lightBenchmarkFrameTime = lightBenchmarkCullTime = lightBenchmarkLightingTime = 0.0;
+                if (++lightBenchmarkRun == lightCountStepsSize)
+                    break;
+                sceneLightCount = lightCountSteps[lightBenchmarkRun];
+                // every light count replays the same frames
+                frameClock.SetTimeSource(FrameClock::FixedTime(1.0 / 60.0));
+            }
+        }
+
+        if (benchmark) {
+            // wait for the GPU so the frame time covers the whole frame
+            glFinish();
+            gpuProfiler.Flush();
+            if (benchmarkFrame >= benchmarkWarmup) {
+                BenchmarkRun &run = benchmarkRuns[benchmarkRun];
+                run.frameTimes.push_back((elapsedSeconds() - frameStart) * 1000.0);
+                for (unsigned int pass = 0; pass < PASS_COUNT; pass++)
+                    if (gpuProfiler.Stats(pass).samples > 0)
+                        run.passTimes[pass].push_back(gpuProfiler.Stats(pass).last);
+            }
+            if (++benchmarkFrame == benchmarkFrames) {
+                benchmarkFrame = 0;
+                // passes of the previous path must not leak into the next run, and both paths replay the same frames
+                gpuProfiler.Reset();
+                frameClock.SetTimeSource(FrameClock::FixedTime(benchmarkTimestep));
+                if (++benchmarkRun == benchmarkRuns.size()) {
+                    std::vector<std::pair<std::string, double>> startup = StartupReport::Phases();
+                    if (benchmarkOutput.empty()) {
+                        writeBenchmarkReport(std::cout, benchmarkRuns, startup, benchmarkFrames, benchmarkWarmup,
+                                             benchmarkTimestep, headless);
+                    }
+                    else {
+                        std::ofstream out(benchmarkOutput);
+                        writeBenchmarkReport(out, benchmarkRuns, startup, benchmarkFrames, benchmarkWarmup,
+                                             benchmarkTimestep, headless);
+                        std::cout << "Benchmark report written to " << benchmarkOutput << std::endl;
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (regression) {
+            glFinish();
+            gpuProfiler.Flush();
+            // the captured frame waits for its readbacks, it isn't timed
+            if (regressionFrame >= regressionWarmup && regressionFrame + 1 < regressionFrames) {
+                regressionTimes[0].push_back((elapsedSeconds() - frameStart) * 1000.0);
+                for (unsigned int pass = 0; pass < PASS_COUNT; pass++)
+                    if (gpuProfiler.Stats(pass).samples > 0)
+                        regressionTimes[pass + 1].push_back(gpuProfiler.Stats(pass).last);
+            }
+            if (++regressionFrame == regressionFrames) {
+                const RegressionView &view = regressionRuns[regressionRun];
+                frameCapture.Flush();
+                std::cout << "Regression view: " << view.name << std::endl;
+                regressionSuite->CompareImage(view.name);
+                if (view.ssao) {
+                    for (const RegressionIntermediate &intermediate : regressionIntermediates) {
+                        std::string name = std::string(view.name) + intermediate.suffix;
+                        if (intermediate.format == FrameCapture::PFM)
+                            regressionSuite->CompareFloatImage(name);
+                        else
+                            regressionSuite->CompareImage(name);
+                    }
+                }
+                RegressionSuite::Timings timings = { { "frame", regressionTimes[0] } };
+                for (unsigned int pass = 0; pass < PASS_COUNT; pass++)
+                    timings.push_back({ renderPassNames[pass], regressionTimes[pass + 1] });
+                regressionSuite->CompareTimings(view.name, (const char *) glGetString(GL_RENDERER), timings);
+
+                // the next view starts from the same clock and with empty pass histories
+                regressionFrame = 0;
+                regressionTimes.assign(PASS_COUNT + 1, std::vector<double>());
+                gpuProfiler.Reset();
+                frameClock.SetTimeSource(FrameClock::FixedTime(benchmarkTimestep));
+                if (++regressionRun == regressionRuns.size()) {
+                    exitCode = regressionSuite->Result();
+                    break;
+                }
+            }
+        }
+
+        if (playback) {
+            playbackFrameTimes[cameraTrack.SegmentOf(playbackFrame)].push_back((elapsedSeconds() - frameStart) * 1000.0);
+            if (++playbackFrame == cameraTrack.FrameCount()) {
+                std::cout << "Playback: " << playPath << ", " << cameraTrack.FrameCount() << " frames" << std::endl;
+                std::cout << std::left << std::setw(20) << "segment" << std::setw(8) << "frames" << std::setw(10)
+                          << "avg ms" << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" << std::setw(10)
+                          << "p99 ms" << "max ms" << std::endl;
+                for (unsigned int segment = 0; segment < playbackFrameTimes.size(); segment++) {
+                    const std::vector<double> &times = playbackFrameTimes[segment];
+                    double sum = 0.0;
+                    for (double time : times)
+                        sum += time;
+                    std::cout << std::left << std::setw(20) << cameraTrack.Segments()[segment].name
+                              << std::setw(8) << times.size() << std::fixed << std::setprecision(3)
+                              << std::setw(10) << (times.empty() ? 0.0 : sum / times.size())
+                              << std::setw(10) << percentile(times, 50.0) << std::setw(10) << percentile(times, 95.0)
+                              << std::setw(10) << percentile(times, 99.0) << percentile(times, 100.0) << std::endl;
+                }
+                break;
+            }
+        }
+    }
+    shaderWatcher.Stop();
+    if (shaderReloadWindow)
+        glfwDestroyWindow(shaderReloadWindow);
+    frameCapture.Flush();
+    if (!captureDirectory.empty())
+        std::cout << "Frame capture: " << frameCapture.Written() << " frames written to " << captureDirectory
+                  << ", " << frameCapture.Dropped() << " dropped" << std::endl;
+    LatencyProbe::Stats inputLatency = latencyProbe.CompleteStats();
+    if (inputLatency.count > 0)
+        std::cout << "Input to GPU done: p50 " << inputLatency.p50 << " ms, p99 " << inputLatency.p99
+                  << " ms, max " << inputLatency.max << " ms over the last " << inputLatency.samples << " of "
+                  << inputLatency.count << " frames with input" << std::endl;
+    if (recordingTrack && cameraTrack.Save(recordPath))
+        std::cout << "Camera track written to " << recordPath << " (" << cameraTrack.FrameCount() << " frames)"
+                  << std::endl;
+    if (!tracePath.empty())
+        writeCpuTrace(tracePath);
+    if (window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
     }
+#ifdef RG_HEADLESS
+    headlessContext.Destroy();
+#endif
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
+    RG_PROFILE_ZONE("input");
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    }
+    SimulationInput held;
+    held.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    held.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    held.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    held.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
     if(glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS){
         ssaoButton=true;
     }
     if(glfwGetKey(window, GLFW_KEY_X) == GLFW_RELEASE){
         ssaoButton=false;
     }
+
+    // roll the ship while turning (applied in the fixed-step simulation) and tilt it while moving
+    held.shipTurn = (held.left ? 1 : 0) - (held.right ? 1 : 0);
+    held.shipTilt = (held.forward ? 3.0f : 0.0f) - (held.backward ? 3.0f : 0.0f);
+
+    // the simulation thread moves the camera in its steps, otherwise it moves here by the frame's time
+    if (simulationThread) {
+        simulationThread->SetHeldInput(held);
+        return;
+    }
+    if (held.forward)
+        camera.ProcessKeyboard(FORWARD, frameClock.DeltaTime());
+    if (held.backward)
+        camera.ProcessKeyboard(BACKWARD, frameClock.DeltaTime());
+    if (held.left)
+        camera.ProcessKeyboard(LEFT, frameClock.DeltaTime());
+    if (held.right)
+        camera.ProcessKeyboard(RIGHT, frameClock.DeltaTime());
+    shipTurn = held.shipTurn;
+    shipTilt = held.shipTilt;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -795,6 +1557,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
+    latencyProbe.OnInput();
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -807,17 +1570,24 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
 
-    if (cameraMouseMovementUpdateEnabled)
+    if (cameraMouseMovementUpdateEnabled && simulationThread)
+        simulationThread->AddMouseMovement(xoffset, yoffset);
+    else if (cameraMouseMovementUpdateEnabled)
         camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    camera.ProcessMouseScroll(yoffset);
+    latencyProbe.OnInput();
+    if (simulationThread)
+        simulationThread->AddScroll(yoffset);
+    else
+        camera.ProcessMouseScroll(yoffset);
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    latencyProbe.OnInput();
     if(key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
@@ -825,15 +1595,66 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         cameraMouseMovementUpdateEnabled = !cameraMouseMovementUpdateEnabled;
         mouseEnabled = !mouseEnabled;
     }
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        unsigned int step = 0;
+        while (step < lightCountStepsSize && lightCountSteps[step] != sceneLightCount)
+            step++;
+        sceneLightCount = lightCountSteps[(step + 1) % lightCountStepsSize];
+        std::cout << "Point lights: " << sceneLightCount << std::endl;
+    }
+    if (key == GLFW_KEY_K && action == GLFW_PRESS && rg::glCaps.computeShaders) {
+        computeSSAO = !computeSSAO;
+        std::cout << "SSAO path: " << (computeSSAO ? "compute" : "fragment") << std::endl;
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        depthPrepass = !depthPrepass;
+        std::cout << "Depth pre-pass: " << (depthPrepass ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        writeCpuTrace("cpu_trace.json");
+    }
+    if (key == GLFW_KEY_N && action == GLFW_PRESS && recordingTrack) {
+        std::string name = "segment " + std::to_string(cameraTrack.Segments().size() + 1);
+        cameraTrack.BeginSegment(name);
+        std::cout << "Camera track: " << name << " starts at frame " << cameraTrack.FrameCount() << std::endl;
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        screenshotRequested = true;
+    }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        framePacer.SetVsync((FramePacer::Vsync) ((framePacer.GetVsync() + 1) % FramePacer::VSYNC_MODE_COUNT));
+        applyVsync();
+    }
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        showProfiler = !showProfiler;
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        aoAlgorithm = (AOAlgorithm) ((aoAlgorithm + 1) % AO_ALGORITHM_COUNT);
+        std::cout << "Ambient occlusion: " << aoAlgorithmNames[aoAlgorithm] << std::endl;
+    }
+}
+
+// sets the window's swap interval from framePacer; adaptive needs EXT_swap_control_tear, without it it's plain vsync
+void applyVsync() {
+    FramePacer::Vsync mode = framePacer.GetVsync();
+    if (mode == FramePacer::VSYNC_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+        std::cout << "Adaptive vsync is not supported, using vsync on" << std::endl;
+        mode = FramePacer::VSYNC_ON;
+    }
+    glfwSwapInterval(FramePacer::SwapInterval(mode));
+    std::cout << "Vsync: " << FramePacer::VsyncName(mode) << std::endl;
 }
 
 unsigned int loadTexture(char const * path)
 {
+    StartupReport::Asset asset("texture", path);
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
     unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    StartupReport::AddBytesRead(StartupReport::FileSize(path));
     if (data)
     {
         GLenum format;
@@ -846,7 +1667,9 @@ unsigned int loadTexture(char const * path)
 
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        StartupReport::AddBytesUploaded((size_t) width * height * nrComponents);
         glGenerateMipmap(GL_TEXTURE_2D);
+        GpuMemory::TrackTexture(textureID, GpuMemory::MATERIAL_TEXTURE, path, width, height, format, true);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -866,6 +1689,7 @@ unsigned int loadTexture(char const * path)
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
+    StartupReport::Asset asset("cubemap", faces.empty() ? "" : faces[0]);
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -873,10 +1697,13 @@ unsigned int loadCubemap(vector<std::string> faces)
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
+        StartupReport::Asset faceAsset("cubemap face", faces[i]);
         unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        StartupReport::AddBytesRead(StartupReport::FileSize(faces[i]));
         if (data)
         {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            StartupReport::AddBytesUploaded((size_t) width * height * nrChannels);
             stbi_image_free(data);
         }
         else
@@ -885,6 +1712,8 @@ unsigned int loadCubemap(vector<std::string> faces)
             stbi_image_free(data);
         }
     }
+    GpuMemory::TrackTexture(textureID, GpuMemory::CUBEMAP, faces.empty() ? "" : faces[0], width, height, GL_RGB,
+                            false, faces.size());
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -894,6 +1723,638 @@ unsigned int loadCubemap(vector<std::string> faces)
     return textureID;
 }
 
+// moves the scene's entities to the given time and lists the ones to draw; the ship follows the camera.
+// Only what was moved and what hangs below it gets new world matrices in the scene's update
+// -----------------------------------------------------------------------------------------------------
+void buildScene(std::vector<Scene::Entity> &draws, Model &planetModel, Model &shipModel, Model &rockModel, float time)
+{
+    RG_PROFILE_ZONE("build matrices");
+    if (scene.Size() == 0 || sceneEntities.asteroidCount != stressAsteroidCount)
+        createSceneEntities(planetModel, shipModel, rockModel);
+    glm::vec3 rockScale = glm::vec3(0.7f);
+
+    scene.SetLocal(sceneEntities.cameraRig, glm::translate(glm::mat4(1.0f), camera.Position +
+                   glm::vec3(camera.Front.x, camera.Front.y - 0.4f, camera.Front.z - 0.8f)));
+    glm::mat4 model1 = glm::mat4(1.0f);
+    model1 = glm::scale(model1, glm::vec3(0.0001f));
+    model1 = glm::rotate(model1, (float) glm::radians(rotateAngle), glm::vec3(0.0f, 0.0f, 1.0f));
+    model1 = glm::rotate(model1, (float) glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model1 = glm::rotate(model1, glm::radians(-camera.Yaw + 90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model1 = glm::rotate(model1, glm::radians(shipTilt), glm::vec3(1.0f, 0.0f, 0.0f));
+    scene.SetLocal(sceneEntities.ship, model1);
+
+    Scene::Entity rock = sceneEntities.rocks;
+    glm::mat4 model2 = glm::mat4(1.0f);
+    glm::vec3 rotation = glm::vec3(20.0f * glm::cos(time),
+                                   10.0f * glm::sin(time) * glm::cos(time),
+                                   20.0f * glm::sin(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 1.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::cos(time), 20.0f * glm::sin(time),
+                         20.0f * glm::sin(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(1.0f, 0.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::cos(time), 20.0f * glm::cos(time),
+                         20.0f * glm::sin(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(30.0), glm::vec3(0.0f, 0.0f, 1.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::sin(time), 20.0f * glm::sin(time),
+                         20.0f * glm::cos(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 1.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::sin(time), 20.0f * glm::cos(time),
+                         20.0f * glm::cos(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(1.0f, 0.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f, 20.0f * glm::sin(time), 20.0f * glm::cos(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(60.0), glm::vec3(0.0f, 0.0f, 1.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::cos(time), 20.0f * glm::sin(time), 20.0f);
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 1.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f * glm::sin(time), 20.0f * glm::cos(time), 20.0f);
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(1.0f, 0.0f, 0.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    model2 = glm::mat4(1.0f);
+    rotation = glm::vec3(20.0f, 20.0f * glm::cos(time), 20.0f * glm::sin(time));
+    model2 = glm::translate(model2, rotation);
+    model2 = glm::rotate(model2, (float) glm::radians(90.0), glm::vec3(0.0f, 0.0f, 1.0f));
+    model2 = glm::scale(model2, rockScale);
+    scene.SetLocal(rock++, model2);
+
+    // stress belt: golden-angle spacing and fixed pseudo-random radius, height and size, the same every run;
+    // every rock is its own entity, so the workers set them in parallel
+    jobSystem->ParallelFor(stressAsteroidCount, 512, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float angle = i * 2.39996323f + time * 0.05f;
+            float radius = 25.0f + 15.0f * std::fmod(i * 0.618034f, 1.0f);
+            float height = 3.0f * std::sin(i * 12.9898f);
+            glm::mat4 rock = glm::translate(glm::mat4(1.0f), glm::vec3(radius * std::cos(angle), height,
+                                                                       radius * std::sin(angle)));
+            rock = glm::rotate(rock, (float) i, glm::normalize(glm::vec3(std::sin((float) i), std::cos(i * 0.7f), 0.5f)));
+            rock = glm::scale(rock, rockScale * (0.3f + 0.4f * std::fmod(i * 0.381966f, 1.0f)));
+            scene.SetLocal(sceneEntities.asteroids + i, rock);
+        }
+    });
+    scene.Update();
+
+    draws.clear();
+    const std::vector<Model *> &models = scene.Models();
+    for (Scene::Entity entity = 0; entity < models.size(); entity++)
+        if (models[entity])
+            draws.push_back(entity);
+}
+
+// (re)creates the entities of the scene, for the current number of stress asteroids; buildScene places them
+// -----------------------------------------------------------------------------------------------------------
+void createSceneEntities(Model &planetModel, Model &shipModel, Model &rockModel)
+{
+    scene.Clear();
+    glm::vec3 planetPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, planetPosition);
+    model = glm::scale(model, glm::vec3(4.0f));
+    sceneEntities.planet = scene.Create(Scene::NONE, model, &planetModel, 128.0f);
+    sceneEntities.cameraRig = scene.Create();
+    sceneEntities.ship = scene.Create(sceneEntities.cameraRig, glm::mat4(1.0f), &shipModel, 2.0f);
+    sceneEntities.rocks = scene.Size();
+    for (unsigned int i = 0; i < 9; i++)
+        scene.Create(Scene::NONE, glm::mat4(1.0f), &rockModel, 2.0f);
+    sceneEntities.asteroids = scene.Size();
+    for (unsigned int i = 0; i < stressAsteroidCount; i++)
+        scene.Create(Scene::NONE, glm::mat4(1.0f), &rockModel, 2.0f);
+    sceneEntities.asteroidCount = stressAsteroidCount;
+}
+
+// sorts opaque draws by view depth of their origin, nearest first, so the depth test rejects
+// hidden fragments before they are shaded
+// ----------------------------------------------------------------------------------------------
+void sortFrontToBack(std::vector<Scene::Entity> &draws, const glm::mat4 &view)
+{
+    RG_PROFILE_ZONE("sort draws");
+    // every draw's depth is computed once, in parallel, and the (depth, entity) keys are sorted; the entity
+    // breaks ties, so the order is the same however many workers there are
+    static std::vector<std::pair<float, Scene::Entity>> keys;
+    const std::vector<glm::mat4> &world = scene.WorldMatrices();
+    keys.resize(draws.size());
+    jobSystem->ParallelFor(draws.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            // view space looks down -z, so the nearer draw has the larger z
+            keys[i] = { -(view * world[draws[i]][3]).z, draws[i] };
+    });
+    jobSystem->ParallelSort(keys.begin(), keys.end(), std::less<std::pair<float, Scene::Entity>>(), 4096);
+    for (size_t i = 0; i < keys.size(); i++)
+        draws[i] = keys[i].second;
+}
+
+// DrawData of draw_data.glsl in std140 layout, the columns of a mat3 are padded to vec4
+struct DrawData {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];
+    float shininess;
+    float padding[3];
+};
+
+// normalView rotates the world-space normal matrices into the space the shader wants its normals in
+void drawScene(Shader &shader, const std::vector<Scene::Entity> &draws, const glm::mat3 &normalView)
+{
+    if (draws.empty())
+        return;
+    // on every call, a program rebuilt by hot reload starts without the binding
+    GLuint block = glGetUniformBlockIndex(shader.ID, "DrawData");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.ID, block, DRAW_DATA_BINDING);
+
+    // all the pass's blocks in one allocation, each at an offset glBindBufferRange accepts
+    GLsizeiptr alignment = drawUploads->UniformAlignment();
+    GLsizeiptr stride = (sizeof(DrawData) + alignment - 1) / alignment * alignment;
+    UploadRing::Allocation upload = drawUploads->AllocateUniform(stride * draws.size());
+    {
+        RG_PROFILE_ZONE("write draw data");
+        for (size_t i = 0; i < draws.size(); i++) {
+            Scene::Entity entity = draws[i];
+            glm::mat3 normalMatrix = normalView * scene.NormalMatrix(entity);
+            DrawData data;
+            data.model = scene.World(entity);
+            for (int column = 0; column < 3; column++)
+                data.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+            data.shininess = scene.Shininess(entity);
+            // write-combined memory: one sequential copy, never read back
+            memcpy((char *) upload.data + i * stride, &data, sizeof(data));
+        }
+    }
+    drawUploads->Commit();
+
+    for (size_t i = 0; i < draws.size(); i++) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, upload.buffer, upload.offset + i * stride,
+                          sizeof(DrawData));
+        RG_PROFILE_ZONE("Model::Draw");
+        scene.GetModel(draws[i])->Draw(shader);
+    }
+}
+
+std::vector<glm::vec3> generateSSAOKernel(unsigned int kernelSize)
+{
+    std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
+    std::default_random_engine generator;
+    std::vector<glm::vec3> ssaoKernel;
+    for (unsigned int i = 0; i < kernelSize; ++i)
+    {
+        glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
+        sample = glm::normalize(sample);
+        sample *= randomFloats(generator);
+        float scale = float(i) / kernelSize;
+
+        // scale samples s.t. they're more aligned to center of kernel
+        scale = lerp(0.1f, 1.0f, scale * scale);
+        sample *= scale;
+        ssaoKernel.push_back(sample);
+    }
+    return ssaoKernel;
+}
+
+// sets the sampleCount-dependent uniforms of the given AO algorithm; expects the shader to be in use. The fragment
+// passes have the count compiled in (SAMPLE_COUNT, split into directions/slices and steps by the shaders), only
+// the SSAO kernel is uploaded and only the compute pass reads the count from a uniform
+// -------------------------------------------------------------------------------------------------------------
+void configureAOShader(Shader &shader, AOAlgorithm algorithm, unsigned int sampleCount, bool compute)
+{
+    if (sampleCount > AO_MAX_SAMPLES)
+        sampleCount = AO_MAX_SAMPLES;
+    if (algorithm == AO_SSAO) {
+        // the kernel only has to be re-uploaded when its size changes, per program
+        static std::map<unsigned int, unsigned int> uploadedKernelSize;
+        if (uploadedKernelSize[shader.ID] != sampleCount) {
+            std::vector<glm::vec3> ssaoKernel = generateSSAOKernel(sampleCount);
+            for (unsigned int i = 0; i < sampleCount; ++i)
+                shader.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
+            uploadedKernelSize[shader.ID] = sampleCount;
+        }
+        // the fragment permutations have the size compiled in, only the compute pass reads it as a uniform
+        if (compute)
+            shader.setInt("kernelSize", sampleCount);
+    }
+}
+
+// places the camera on a fixed orbit around the planet, looking at its center
+// ---------------------------------------------------------------------------
+void setBenchmarkCamera(unsigned int frame, unsigned int frameCount)
+{
+    float angle = 2.0f * 3.14159265f * frame / frameCount;
+    camera.Position = glm::vec3(30.0f * std::cos(angle), 5.0f, 30.0f * std::sin(angle));
+    glm::vec3 front = glm::normalize(-camera.Position);
+    camera.Yaw = glm::degrees(std::atan2(front.z, front.x));
+    camera.Pitch = glm::degrees(std::asin(front.y));
+    // a zero mouse offset recomputes the camera vectors from the new angles
+    camera.ProcessMouseMovement(0.0f, 0.0f);
+}
+
+// the projection every benchmark renders with
+// -------------------------------------------
+glm::mat4 benchmarkProjection()
+{
+    return glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+}
+
+// one row of a benchmark table: each cell left-aligned in its column, the last one unpadded
+// -----------------------------------------------------------------------------------------
+void printTableRow(const std::vector<std::string> &cells, const std::vector<int> &widths)
+{
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (i + 1 < cells.size())
+            std::cout << std::left << std::setw(widths[i]);
+        std::cout << cells[i];
+    }
+    std::cout << std::endl;
+}
+
+std::string formatFixed(double value, int precision)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(precision) << value;
+    return out.str();
+}
+
+// AO benchmark: fly a fixed camera path and run every AO algorithm at several sample counts
+// on the same G-buffer, timing the AO and blur passes and comparing the blurred result to a
+// high-sample reference. With GL 4.3 the compute SSAO path runs as its own configuration.
+// -------------------------------------------------------------------------------------------
+void runAOBenchmark(BenchmarkRenderer &renderer)
+{
+    struct AOConfiguration {
+        const char *name;
+        AOAlgorithm algorithm;
+        bool compute;
+    };
+    std::vector<AOConfiguration> configurations;
+    for (int algorithm = 0; algorithm < AO_ALGORITHM_COUNT; algorithm++)
+        configurations.push_back({ aoAlgorithmNames[algorithm], (AOAlgorithm) algorithm, false });
+    if (rg::glCaps.computeShaders)
+        configurations.push_back({ "SSAO-CS", AO_SSAO, true });
+
+    const unsigned int frameCount = 60;
+    const unsigned int sampleCounts[] = { 8, 16, 32, 64 };
+    const unsigned int runCount = sizeof(sampleCounts) / sizeof(sampleCounts[0]);
+    // build every permutation up front, compiling doesn't belong in the first measured frame
+    for (int algorithm = 0; algorithm < AO_ALGORITHM_COUNT; algorithm++) {
+        renderer.aoShader((AOAlgorithm) algorithm, AO_MAX_SAMPLES);
+        for (unsigned int sampleCount : sampleCounts)
+            renderer.aoShader((AOAlgorithm) algorithm, sampleCount);
+    }
+    std::vector<double> aoTime(configurations.size() * runCount), blurTime(configurations.size() * runCount);
+    std::vector<double> squaredError(configurations.size() * runCount);
+    std::vector<float> reference(SCR_WIDTH * SCR_HEIGHT), image(SCR_WIDTH * SCR_HEIGHT);
+    glm::mat4 projection = benchmarkProjection();
+    auto readBlurredAO = [&](std::vector<float> &result) {
+        glBindFramebuffer(GL_FRAMEBUFFER, renderer.ssaoBlurFBO);
+        glReadPixels(0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RED, GL_FLOAT, &result[0]);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+    };
+
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        setBenchmarkCamera(frame, frameCount);
+        renderer.renderGeometryPass(renderer.shaderGeometryPass, projection, camera.GetViewMatrix(), frame / 60.0f);
+
+        for (unsigned int c = 0; c < configurations.size(); c++) {
+            // the reference always comes from the fragment path
+            if (c == 0 || configurations[c].algorithm != configurations[c - 1].algorithm) {
+                renderer.renderAmbientOcclusion(configurations[c].algorithm, AO_MAX_SAMPLES, false, projection, NULL);
+                readBlurredAO(reference);
+            }
+            for (unsigned int run = 0; run < runCount; run++) {
+                renderer.renderAmbientOcclusion(configurations[c].algorithm, sampleCounts[run],
+                                                configurations[c].compute, projection, &renderer.gpuProfiler);
+                readBlurredAO(image);
+                renderer.gpuProfiler.Flush();
+                aoTime[c * runCount + run] += renderer.gpuProfiler.Stats(PASS_AO).last;
+                blurTime[c * runCount + run] += renderer.gpuProfiler.Stats(PASS_BLUR).last;
+                double frameError = 0.0;
+                for (size_t i = 0; i < image.size(); i++)
+                    frameError += (image[i] - reference[i]) * (image[i] - reference[i]);
+                squaredError[c * runCount + run] += frameError / image.size();
+            }
+        }
+        renderer.presentFrame();
+    }
+
+    std::cout << "AO benchmark: " << SCR_WIDTH << "x" << SCR_HEIGHT << ", " << frameCount << " frames, reference "
+              << AO_MAX_SAMPLES << " samples" << std::endl;
+    const std::vector<int> widths = { 10, 9, 10, 10, 12 };
+    printTableRow({ "algorithm", "samples", "ao ms", "blur ms", "rmse", "psnr dB" }, widths);
+    for (unsigned int c = 0; c < configurations.size(); c++) {
+        for (unsigned int run = 0; run < runCount; run++) {
+            unsigned int i = c * runCount + run;
+            double mse = squaredError[i] / frameCount;
+            printTableRow({ configurations[c].name, std::to_string(sampleCounts[run]),
+                            formatFixed(aoTime[i] / frameCount, 3), formatFixed(blurTime[i] / frameCount, 3),
+                            formatFixed(std::sqrt(mse), 5),
+                            formatFixed(mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : 99.99, 2) }, widths);
+        }
+    }
+}
+
+// pre-pass benchmark: fly the benchmark orbit through the forward opaque pass with and without the
+// depth pre-pass and front-to-back sorting, and report GPU time and fragment shader invocations
+// ----------------------------------------------------------------------------------------------
+void runPrepassBenchmark(BenchmarkRenderer &renderer)
+{
+    struct PrepassConfiguration {
+        bool prepass;
+        bool sorted;
+    };
+    const PrepassConfiguration configurations[] = { { false, false }, { false, true }, { true, false }, { true, true } };
+    const unsigned int configurationCount = sizeof(configurations) / sizeof(configurations[0]);
+    const unsigned int frameCount = 120;
+    double opaqueTime[configurationCount] = {}, fragments[configurationCount] = {};
+    unsigned int queries[2];
+    glGenQueries(2, queries);
+    glm::mat4 projection = benchmarkProjection();
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        setBenchmarkCamera(frame, frameCount);
+        for (unsigned int c = 0; c < configurationCount; c++) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.renderForwardOpaque(projection, camera.GetViewMatrix(), frame / 60.0f, configurations[c].prepass,
+                                         configurations[c].sorted, queries);
+            GLuint64 elapsed = 0, invocations = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &elapsed);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &invocations);
+            opaqueTime[c] += elapsed / 1.0e6;
+            fragments[c] += (double) invocations;
+        }
+        renderer.presentFrame();
+    }
+
+    std::cout << "Pre-pass benchmark: " << SCR_WIDTH << "x" << SCR_HEIGHT << ", " << frameCount << " frames, counting "
+              << (rg::glCaps.pipelineStatistics ? "fragment shader invocations" : "samples passed") << std::endl;
+    const std::vector<int> widths = { 10, 15, 12, 14 };
+    printTableRow({ "pre-pass", "order", "opaque ms", "fragments", "per pixel" }, widths);
+    for (unsigned int c = 0; c < configurationCount; c++) {
+        printTableRow({ configurations[c].prepass ? "on" : "off",
+                        configurations[c].sorted ? "front-to-back" : "fixed",
+                        formatFixed(opaqueTime[c] / frameCount, 3), formatFixed(fragments[c] / frameCount, 0),
+                        formatFixed(fragments[c] / frameCount / (SCR_WIDTH * SCR_HEIGHT), 3) }, widths);
+    }
+    glDeleteQueries(2, queries);
+}
+
+// normal matrix benchmark: fly the benchmark orbit through the geometry pass with the normal matrices from the
+// CPU and with the old per-vertex inverse, and report the GPU time of both
+// ---------------------------------------------------------------------------------------------------------
+void runNormalMatrixBenchmark(BenchmarkRenderer &renderer)
+{
+    Shader shaderGeometryPerVertex({ { GL_VERTEX_SHADER, "resources/shaders/ssao_geometry.vs" },
+                                     { GL_FRAGMENT_SHADER, "resources/shaders/ssao_geometry.fs" } },
+                                   { { "NORMAL_MATRIX_PER_VERTEX", "" } });
+    Shader *shaders[] = { &renderer.shaderGeometryPass, &shaderGeometryPerVertex };
+    const char *names[] = { "per object (CPU)", "per vertex (GPU)" };
+    const unsigned int frameCount = 120;
+    double geometryTime[2] = {};
+    unsigned int query;
+    glGenQueries(1, &query);
+    glm::mat4 projection = benchmarkProjection();
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        setBenchmarkCamera(frame, frameCount);
+        for (unsigned int c = 0; c < 2; c++) {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            renderer.renderGeometryPass(*shaders[c], projection, camera.GetViewMatrix(), frame / 60.0f);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            geometryTime[c] += elapsed / 1.0e6;
+        }
+        renderer.presentFrame();
+    }
+
+    std::cout << "Normal matrix benchmark: " << SCR_WIDTH << "x" << SCR_HEIGHT << ", " << frameCount
+              << " frames, " << stressAsteroidCount << " extra asteroids" << std::endl;
+    const std::vector<int> widths = { 20 };
+    printTableRow({ "normal matrix", "geometry ms" }, widths);
+    for (unsigned int c = 0; c < 2; c++)
+        printTableRow({ names[c], formatFixed(geometryTime[c] / frameCount, 3) }, widths);
+    glDeleteQueries(1, &query);
+}
+
+// job benchmark: the per-frame CPU work of the benchmark orbit (transforms, light culling, front-to-back sort)
+// with 0 workers up to the --jobs count, that is on 1 to N cores, and how much faster each is than one core
+// ----------------------------------------------------------------------------------------------------------
+void runJobBenchmark(BenchmarkRenderer &renderer)
+{
+    const unsigned int frameCount = 120;
+    if (stressAsteroidCount == 0)
+        stressAsteroidCount = 100000;
+    std::vector<PointLight> benchmarkLights = createSceneLights(10000), movedLights = benchmarkLights;
+    unsigned int maxWorkers = renderer.jobs.Workers();
+    glm::mat4 projection = benchmarkProjection();
+    std::cout << "Job benchmark: " << frameCount << " frames, " << stressAsteroidCount << " extra asteroids, "
+              << benchmarkLights.size() << " lights" << std::endl;
+    const std::vector<int> widths = { 8, 16, 14, 10, 12 };
+    printTableRow({ "cores", "transforms ms", "culling ms", "sort ms", "total ms", "speedup" }, widths);
+    double oneCore = 0.0;
+    for (unsigned int workers = 0; workers <= maxWorkers; workers++) {
+        JobSystem pool(workers);
+        jobSystem = &pool;
+        double times[3] = {};
+        for (unsigned int frame = 0; frame < frameCount; frame++) {
+            setBenchmarkCamera(frame, frameCount);
+            glm::mat4 view = camera.GetViewMatrix();
+            float time = frame / 60.0f;
+            animateSceneLights(movedLights, benchmarkLights, time);
+            double start = elapsedSeconds();
+            buildScene(renderer.sceneDraws, renderer.planetModel, renderer.shipModel, renderer.rockModel, time);
+            double built = elapsedSeconds();
+            renderer.clusteredLights.Update(movedLights, view, projection, 0.1f, 100.0f, jobSystem);
+            double culled = elapsedSeconds();
+            sortFrontToBack(renderer.sceneDraws, view);
+            times[0] += built - start;
+            times[1] += culled - built;
+            times[2] += elapsedSeconds() - culled;
+        }
+        double total = (times[0] + times[1] + times[2]) * 1000.0 / frameCount;
+        if (workers == 0)
+            oneCore = total;
+        printTableRow({ std::to_string(workers + 1), formatFixed(times[0] * 1000.0 / frameCount, 3),
+                        formatFixed(times[1] * 1000.0 / frameCount, 3), formatFixed(times[2] * 1000.0 / frameCount, 3),
+                        formatFixed(total, 3), formatFixed(oneCore / total, 2) + "x" }, widths);
+    }
+    jobSystem = &renderer.jobs;
+}
+
+// scene benchmark: world matrix updates of a million entities (10000 subtrees of 100) in the scene store with
+// every subtree, 1% of them and none moved, against rebuilding every matrix into a list of draw structs the
+// way the scene used to be built; then one pass over all world matrices (the depth keys of the sort) from the
+// store's array and from the list
+// -----------------------------------------------------------------------------------------------------------
+void runSceneBenchmark(BenchmarkRenderer &renderer)
+{
+    struct FlatDraw {
+        Model *model;
+        glm::mat4 transform;
+        float shininess;
+        glm::mat3 normalMatrix;
+    };
+    const unsigned int subtrees = 10000, subtreeSize = 100, runs = 10;
+    Scene benchmarkScene;
+    std::vector<Scene::Entity> roots;
+    std::vector<glm::mat4> childTransforms;
+    for (unsigned int i = 0; i < subtrees; i++) {
+        roots.push_back(benchmarkScene.Create(Scene::NONE, glm::translate(glm::mat4(1.0f), glm::vec3((float) i, 0.0f, 0.0f))));
+        for (unsigned int j = 1; j < subtreeSize; j++) {
+            glm::mat4 child = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, (float) j, 0.0f)),
+                                          (float) j, glm::vec3(0.0f, 1.0f, 0.0f));
+            childTransforms.push_back(child);
+            benchmarkScene.Create(roots.back(), child, &renderer.rockModel, 2.0f);
+        }
+    }
+    benchmarkScene.Update();
+    std::vector<FlatDraw> flatDraws(benchmarkScene.Size());
+    glm::mat4 view = camera.GetViewMatrix();
+
+    auto moveRoots = [&](unsigned int every, float time) {
+        for (unsigned int i = 0; i < subtrees; i += every)
+            benchmarkScene.SetLocal(roots[i], glm::translate(glm::mat4(1.0f), glm::vec3((float) i, time, 0.0f)));
+    };
+    double times[6] = {};
+    unsigned int recomputed[3] = {};
+    for (unsigned int run = 0; run < runs; run++) {
+        float time = run + 1.0f;
+        double start = elapsedSeconds();
+        moveRoots(1, time);
+        recomputed[0] = benchmarkScene.Update();
+        double all = elapsedSeconds();
+        moveRoots(100, time);
+        recomputed[1] = benchmarkScene.Update();
+        double some = elapsedSeconds();
+        recomputed[2] = benchmarkScene.Update();
+        double none = elapsedSeconds();
+        for (unsigned int i = 0, draw = 0; i < subtrees; i++) {
+            glm::mat4 root = glm::translate(glm::mat4(1.0f), glm::vec3((float) i, time, 0.0f));
+            flatDraws[draw++] = { NULL, root, 0.0f, glm::mat3(1.0f) };
+            for (unsigned int j = 1; j < subtreeSize; j++) {
+                glm::mat4 transform = root * childTransforms[i * (subtreeSize - 1) + j - 1];
+                flatDraws[draw++] = { &renderer.rockModel, transform, 2.0f, glm::transpose(glm::inverse(glm::mat3(transform))) };
+            }
+        }
+        double flat = elapsedSeconds();
+        // the sum keeps the passes from being optimized away
+        float depthSum = 0.0f;
+        for (const glm::mat4 &world : benchmarkScene.WorldMatrices())
+            depthSum += (view * world[3]).z;
+        double soa = elapsedSeconds();
+        for (const FlatDraw &draw : flatDraws)
+            depthSum -= (view * draw.transform[3]).z;
+        double aos = elapsedSeconds();
+        times[0] += all - start;
+        times[1] += some - all;
+        times[2] += none - some;
+        times[3] += flat - none;
+        times[4] += soa - flat;
+        times[5] += aos - soa;
+        volatile float sink = depthSum;
+        (void) sink;
+    }
+
+    const char *names[6] = { "update, all moved", "update, 1% moved", "update, none moved", "flat rebuild",
+                             "depth pass, store", "depth pass, flat" };
+    std::cout << "Scene benchmark: " << benchmarkScene.Size() << " entities in " << subtrees << " subtrees, "
+              << runs << " runs" << std::endl;
+    const std::vector<int> widths = { 22, 12 };
+    printTableRow({ "", "ms", "world matrices" }, widths);
+    for (unsigned int c = 0; c < 6; c++) {
+        std::string count = c < 3 ? std::to_string(recomputed[c]) : c == 3 ? std::to_string(flatDraws.size()) : "";
+        printTableRow({ names[c], formatFixed(times[c] * 1000.0 / runs, 3), count }, widths);
+    }
+}
+
+// the first light is the original warm key light, the rest are small engine glows, beacons and flashes
+// scattered around the planet; their colors and orbits are fixed so runs stay comparable
+// ----------------------------------------------------------------------------------------------------
+std::vector<PointLight> createSceneLights(unsigned int count)
+{
+    std::vector<PointLight> lights;
+    PointLight keyLight;
+    keyLight.Position = glm::vec3(2.0, 4.0, -2.0);
+    keyLight.Color = glm::vec3(0.86, 0.3f, 0.2f);
+    // distance at which 1 / (1 + 0.09d + 0.032d^2) drops below 5/256
+    keyLight.Radius = 38.0f;
+    lights.push_back(keyLight);
+
+    std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0);
+    std::default_random_engine generator;
+    for (unsigned int i = 1; i < count; i++) {
+        PointLight light;
+        float angle = randomFloats(generator) * 2.0f * 3.14159265f;
+        float distance = lerp(6.0f, 25.0f, randomFloats(generator));
+        light.Position = glm::vec3(distance * std::cos(angle), lerp(-8.0f, 8.0f, randomFloats(generator)),
+                                   distance * std::sin(angle));
+        light.Color = glm::vec3(lerp(0.2f, 1.0f, randomFloats(generator)), lerp(0.2f, 1.0f, randomFloats(generator)),
+                                lerp(0.2f, 1.0f, randomFloats(generator)));
+        light.Radius = lerp(1.5f, 4.0f, randomFloats(generator));
+        lights.push_back(light);
+    }
+    return lights;
+}
+
+// orbits every light except the key light around the planet's y axis at its own speed
+// -----------------------------------------------------------------------------------
+void animateSceneLights(std::vector<PointLight> &lights, const std::vector<PointLight> &baseLights, float time)
+{
+    for (unsigned int i = 1; i < lights.size(); i++) {
+        float angle = time * (0.1f + 0.05f * (i % 7));
+        float c = std::cos(angle), s = std::sin(angle);
+        const glm::vec3 &p = baseLights[i].Position;
+        lights[i].Position = glm::vec3(c * p.x - s * p.z, p.y, s * p.x + c * p.z);
+    }
+}
+
+// draws the skybox behind everything already in the depth buffer
+// ---------------------------------------------------------------
+void renderSkybox(Shader &skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture, const glm::mat4 &projection)
+{
+    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    skyboxShader.use();
+    glm::mat4 view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
+    skyboxShader.setMat4("view", view);
+    skyboxShader.setMat4("projection", projection);
+    // skybox cube
+    glBindVertexArray(skyboxVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS); // set depth function back to default
+}
+
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
 void renderCube()
@@ -950,6 +2411,7 @@ void renderCube()
         // fill buffer
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        GpuMemory::TrackBuffer(cubeVBO, GpuMemory::OTHER, "cube vertices", sizeof(vertices));
         // link vertex attributes
         glBindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
@@ -987,6 +2449,7 @@ void renderQuad()
         glBindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        GpuMemory::TrackBuffer(quadVBO, GpuMemory::OTHER, "quad vertices", sizeof(quadVertices));
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
@@ -996,3 +2459,85 @@ void renderQuad()
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     glBindVertexArray(0);
 }
+
+// dumps the CPU profiler's zones as Chrome trace JSON
+// ---------------------------------------------------
+void writeCpuTrace(const std::string &path)
+{
+#ifdef RG_CPU_PROFILER
+    if (CpuProfiler::WriteChromeTrace(path))
+        std::cout << "CPU trace written to " << path << std::endl;
+    else
+        std::cout << "Failed to write CPU trace " << path << std::endl;
+#else
+    std::cout << "CPU profiler is compiled out, configure with -DRG_CPU_PROFILER=ON" << std::endl;
+#endif
+}
+
+// seconds since the first call, from a monotonic clock that also works without GLFW
+// ---------------------------------------------------------------------------------
+double elapsedSeconds()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// nearest-rank percentile of an unsorted sample
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t) std::ceil(p / 100.0 * values.size());
+    return values[std::min(std::max(rank, (size_t) 1), values.size()) - 1];
+}
+
+void writeTimingStats(std::ostream &out, const std::vector<double> &values)
+{
+    double sum = 0.0;
+    for (double value : values)
+        sum += value;
+    out << "{\"min\": " << percentile(values, 0.0) << ", \"avg\": " << (values.empty() ? 0.0 : sum / values.size())
+        << ", \"p50\": " << percentile(values, 50.0) << ", \"p90\": " << percentile(values, 90.0)
+        << ", \"p95\": " << percentile(values, 95.0) << ", \"p99\": " << percentile(values, 99.0)
+        << ", \"max\": " << percentile(values, 100.0) << "}";
+}
+
+// benchmark results as JSON: times are in milliseconds, pass times are GPU times from the timer queries
+// ---------------------------------------------------------------------------------------------------
+void writeBenchmarkReport(std::ostream &out, const std::vector<BenchmarkRun> &runs,
+                          const std::vector<std::pair<std::string, double>> &startup, unsigned int frames,
+                          unsigned int warmup, float timestep, bool headless)
+{
+    out << std::fixed << std::setprecision(4);
+    out << "{\n";
+    out << "  \"renderer\": \"" << rg::escapeJSON((const char *) glGetString(GL_RENDERER)) << "\",\n";
+    out << "  \"version\": \"" << rg::escapeJSON((const char *) glGetString(GL_VERSION)) << "\",\n";
+    out << "  \"headless\": " << (headless ? "true" : "false") << ",\n";
+    out << "  \"width\": " << SCR_WIDTH << ",\n  \"height\": " << SCR_HEIGHT << ",\n";
+    out << "  \"frames\": " << frames << ",\n  \"warmup\": " << warmup << ",\n";
+    out << "  \"timestep\": " << timestep << ",\n";
+    out << "  \"startup_ms\": {";
+    for (size_t i = 0; i < startup.size(); i++)
+        out << (i ? ", " : "") << "\"" << rg::escapeJSON(startup[i].first) << "\": " << startup[i].second * 1000.0;
+    out << "},\n";
+    out << "  \"gpu_memory\": ";
+    GpuMemory::WriteJSON(out, "  ");
+    out << ",\n";
+    out << "  \"runs\": [\n";
+    for (size_t r = 0; r < runs.size(); r++) {
+        out << "    {\n      \"path\": \"" << rg::escapeJSON(runs[r].path) << "\",\n      \"frame_ms\": ";
+        writeTimingStats(out, runs[r].frameTimes);
+        out << ",\n      \"passes_ms\": {";
+        bool first = true;
+        for (unsigned int pass = 0; pass < runs[r].passTimes.size(); pass++) {
+            if (runs[r].passTimes[pass].empty())
+                continue;
+            out << (first ? "" : ",") << "\n        \"" << renderPassNames[pass] << "\": ";
+            writeTimingStats(out, runs[r].passTimes[pass]);
+            first = false;
+        }
+        out << "\n      }\n    }" << (r + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}